@@ -128,6 +128,10 @@ typedef uint8_t byte;
 void init(void);
 void initVariant(void);
 
+// MCUSR as it was after reset (PORF, EXTRF, BORF, WDRF), the register
+// itself is cleared before main() so the flags describe one reset only.
+uint8_t resetCause(void);
+
 int atexit(void (*func)()) __attribute__((weak));
 
 void pinMode(uint8_t, uint8_t);
@@ -141,6 +145,18 @@ unsigned long millis(void);
 unsigned long micros(void);
 void delay(unsigned long);
 void delayMicroseconds(unsigned int us);
+
+// Runtime system clock division. div is a clock_div_t value from
+// avr/power.h (log2 of the divider). millis(), micros() and the delays keep
+// real time across changes, attached handlers are called before and after
+// the switch to adjust peripherals (UART baud rate, SPI clock).
+#define CLOCK_PRESCALE_BEFORE 0
+#define CLOCK_PRESCALE_AFTER 1
+void setClockPrescale(uint8_t div);
+uint8_t getClockPrescale(void);
+unsigned long getClockFrequency(void);
+void attachClockPrescaleHandler(void (*)(uint8_t));
+void detachClockPrescaleHandler(void (*)(uint8_t));
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout);
 
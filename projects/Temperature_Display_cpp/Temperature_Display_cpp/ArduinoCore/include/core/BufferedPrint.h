@@ -0,0 +1,74 @@
+/*
+  BufferedPrint.h - Write-combining adapter for Print
+  Copyright (c) 2018 Krzysztof Wisniewski.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef BufferedPrint_h
+#define BufferedPrint_h
+
+#include <inttypes.h>
+#include "Print.h"
+
+#ifndef BUFFERED_PRINT_SIZE
+#define BUFFERED_PRINT_SIZE 32
+#endif
+
+// Collects the output of many small print() calls and passes it on to
+// another Print in one write(buffer, size): when the buffer is full, on
+// a newline (unless disabled) and on flush(). Worth it in front of
+// anything with a bulk write() that costs per call, an SPI or I2C
+// display, a USB endpoint, the serial ring buffer.
+//
+//   BufferedPrint out(Serial);
+//   out.print(F("T="));
+//   out.print(t);
+//   out.println();      // one write to Serial
+//
+// Whatever is still buffered is passed on when the adapter goes out of
+// scope.
+//
+// When the target takes fewer bytes than offered, the rest is dropped,
+// setWriteError() is called and write() returns only the bytes of the
+// call which got through or are buffered.
+class BufferedPrint : public Print
+{
+  public:
+    BufferedPrint(Print &out, bool flushOnNewline = true);
+    ~BufferedPrint() { send(); }
+
+    virtual size_t write(uint8_t);
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    virtual int availableForWrite() { return sizeof(_buffer) - _length; }
+
+    // pass the buffered bytes on, then flush the target
+    virtual void flush();
+
+    // pass the buffered bytes on, false if the target took fewer
+    bool send();
+
+  private:
+    uint8_t drain();
+
+    Print &_out;
+    bool _flushOnNewline;
+    uint8_t _length;
+    uint8_t _buffer[BUFFERED_PRINT_SIZE];
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+  ClockScaling.h - Dynamic system clock scaling for Wiring
+  Copyright (c) 2018 Krzysztof Wisniewski.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ClockScaling_h
+#define ClockScaling_h
+
+#include <inttypes.h>
+#include <avr/power.h>
+
+// The number of clock_div_t settings, clock_div_1 .. clock_div_256
+#define CLOCK_SCALING_LEVELS 9
+
+// Keeps the system clock at the lowest frequency allowed by the idle
+// floor, unless a driver requested a faster one for a critical section.
+// Frequencies are expressed as clock_div_t values from avr/power.h, a
+// smaller division means a faster clock.
+//
+// Switching goes through setClockPrescale(), so millis(), micros(), the
+// delays and the UART baud rate stay consistent. Not to be used from
+// interrupt handlers.
+class ClockScalingClass
+{
+  public:
+    ClockScalingClass();
+
+    // Set the division used when nothing is requested and switch to it.
+    void begin(uint8_t idleDiv);
+
+    // Require the clock to be at least F_CPU >> maxDiv until the matching
+    // release(). Requests nest and are reference counted per level.
+    void request(uint8_t maxDiv);
+    void release(uint8_t maxDiv);
+
+    // The division currently in use.
+    uint8_t current() { return _current; }
+
+    // Milliseconds spent at the given division since begin() or reset().
+    unsigned long timeAt(uint8_t div);
+    void resetStats();
+
+  private:
+    void account();
+    void apply();
+
+    uint8_t _idle;
+    uint8_t _current;
+    uint8_t _requests[CLOCK_SCALING_LEVELS];
+    unsigned long _time[CLOCK_SCALING_LEVELS];
+    unsigned long _since;
+};
+
+extern ClockScalingClass ClockScaling;
+
+// Holds a clock request for the lifetime of the object, e.g.
+//
+//   {
+//     ClockRequest boost(clock_div_1);
+//     ... timing critical code ...
+//   }
+class ClockRequest
+{
+  public:
+    ClockRequest(uint8_t maxDiv) : _div(maxDiv) { ClockScaling.request(_div); }
+    ~ClockRequest() { ClockScaling.release(_div); }
+
+  private:
+    ClockRequest(const ClockRequest&);
+    ClockRequest& operator=(const ClockRequest&);
+
+    uint8_t _div;
+};
+
+#endif
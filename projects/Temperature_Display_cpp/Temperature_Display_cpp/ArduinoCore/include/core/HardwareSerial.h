@@ -102,6 +102,9 @@ class HardwareSerial : public Stream
     // Has any byte been written to the UART since begin()
     bool _written;
 
+    // Baud rate requested in begin(), reapplied on clock prescaler changes
+    unsigned long _baud;
+
     volatile rx_buffer_index_t _rx_buffer_head;
     volatile rx_buffer_index_t _rx_buffer_tail;
     volatile tx_buffer_index_t _tx_buffer_head;
@@ -131,12 +134,19 @@ class HardwareSerial : public Stream
     inline size_t write(long n) { return write((uint8_t)n); }
     inline size_t write(unsigned int n) { return write((uint8_t)n); }
     inline size_t write(int n) { return write((uint8_t)n); }
-    using Print::write; // pull in write(str) and write(buf, size) from Print
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    using Print::write; // pull in write(str) and write(char *, size) from Print
     operator bool() { return true; }
 
     // Interrupt handlers - Not intended to be called externally
     inline void _rx_complete_irq(void);
     void _tx_udr_empty_irq(void);
+
+    // Clock prescaler handler - Not intended to be called externally
+    void _clock_prescale_changed(uint8_t phase);
+
+  private:
+    void _set_baud_rate(unsigned long baud);
 };
 
 #if defined(UBRRH) || defined(UBRR0H)
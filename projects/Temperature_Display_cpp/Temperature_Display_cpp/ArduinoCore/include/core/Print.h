@@ -34,12 +34,80 @@
 #endif
 #define BIN 2
 
+// printFloat() formats into a buffer of this size: the 39 integer digits
+// of the largest float (double is float on AVR), sign, point and fraction
+#define PRINT_FLOAT_BUFFER 64
+#define PRINT_FLOAT_DIGITS 20
+// fraction digits computed from the value, more are printed as zeros
+#define PRINT_FLOAT_PRECISION 9
+
+// printFixed() buffer: sign, the digits of a long, point and width
+#define PRINT_FIXED_BUFFER 24
+#define PRINT_FIXED_DIGITS 10
+
+// print(F("...")) copies flash strings in pieces of this size
+#define PRINT_FLASH_CHUNK 16
+
+// format() collects its output in a buffer of this size, longer output
+// goes out in several writes
+#define PRINT_FORMAT_BUFFER 40
+
+class PrintFormat;
+
+// One conversion of a format() string: %[-][0][width][.precision]type
+struct PrintSpec {
+  char conversion;
+  char pad;
+  bool left;
+  uint8_t width;
+  int8_t precision; // -1 if not given
+};
+
+// An argument of Print::format() together with the function formatting
+// it, picked by its C++ type, so the format string can not mismatch it
+// and only the formatters of types actually passed get linked. %c, %d,
+// %u print the value as its type says; %x and %X print integers in hex,
+// negative ones as the two's complement in the width of their type (an
+// int -1 is ffff, a long ffffffff), %s strings, %f floats with the
+// precision (2 by default). Width and precision stop at 255 and 127.
+struct PrintArg {
+  typedef void (*Emitter)(PrintFormat &, const PrintArg &, const PrintSpec &);
+
+  PrintArg(char c) : emit(emitChar) { value.l = c; }
+  PrintArg(int n) : emit(emitInt) { value.l = n; }
+  PrintArg(long n) : emit(emitSigned) { value.l = n; }
+  PrintArg(unsigned char n) : emit(emitUnsigned) { value.ul = n; }
+  PrintArg(unsigned int n) : emit(emitUnsigned) { value.ul = n; }
+  PrintArg(unsigned long n) : emit(emitUnsigned) { value.ul = n; }
+  PrintArg(double n) : emit(emitFloat) { value.d = n; }
+  PrintArg(const char *str) : emit(emitString) { value.s = str; }
+  PrintArg(const __FlashStringHelper *str) : emit(emitFlashString) { value.s = (const char *)str; }
+
+  static void emitChar(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitInt(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitSigned(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitUnsigned(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitFloat(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitString(PrintFormat &, const PrintArg &, const PrintSpec &);
+  static void emitFlashString(PrintFormat &, const PrintArg &, const PrintSpec &);
+
+  Emitter emit;
+  union {
+    long l;
+    unsigned long ul;
+    double d;
+    const char *s;
+  } value;
+};
+
 class Print
 {
   private:
     int write_error;
-    size_t printNumber(unsigned long, uint8_t);
-    size_t printFloat(double, uint8_t);
+    size_t printNumber(unsigned long, uint8_t, bool negative = false);
+    size_t printFloat(double, uint8_t, int width = 0, char pad = ' ');
+    size_t writePadded(char *buf, char *str, char *end, int width, char pad);
+    size_t vformat(const __FlashStringHelper *, const PrintArg *, uint8_t);
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
@@ -72,8 +140,16 @@ class Print
     size_t print(long, int = DEC);
     size_t print(unsigned long, int = DEC);
     size_t print(double, int = 2);
+    // at least |width| characters, padded on the left with pad (on the
+    // right if width is negative)
+    size_t print(double, int, int width, char pad = ' ');
     size_t print(const Printable&);
 
+    // value / 10^fracDigits without floating point, e.g. tenths of a
+    // degree: printFixed(-53, 1) prints "-5.3". Padded on the left to
+    // width characters; a '0' pad goes after the sign.
+    size_t printFixed(int32_t value, uint8_t fracDigits, uint8_t width = 0, char pad = ' ');
+
     size_t println(const __FlashStringHelper *);
     size_t println(const String &s);
     size_t println(const char[]);
@@ -84,9 +160,22 @@ class Print
     size_t println(long, int = DEC);
     size_t println(unsigned long, int = DEC);
     size_t println(double, int = 2);
+    size_t println(double, int, int width, char pad = ' ');
     size_t println(const Printable&);
+    size_t printlnFixed(int32_t value, uint8_t fracDigits, uint8_t width = 0, char pad = ' ');
     size_t println(void);
 
+    // printf-style output in one write: format(F("Temp %u: %.1f *C"), id, t).
+    // The format string stays in flash, see PrintArg for the conversions.
+    template <typename... Args>
+    size_t format(const __FlashStringHelper *fmt, Args... args) {
+      const PrintArg list[] = { PrintArg(args)... };
+      return vformat(fmt, list, sizeof...(args));
+    }
+    size_t format(const __FlashStringHelper *fmt) {
+      return vformat(fmt, 0, 0);
+    }
+
     virtual void flush() { /* Empty implementation for backward compatibility */ }
 };
 
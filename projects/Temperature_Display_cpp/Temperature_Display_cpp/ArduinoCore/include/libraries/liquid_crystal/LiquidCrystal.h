@@ -5,6 +5,7 @@
 #include "Print.h"
 
 #include "SPI.h"
+#include "Twi.h"
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -44,6 +45,143 @@
 #define LCD_5x10DOTS 0x04
 #define LCD_5x8DOTS 0x00
 
+// status read with RW high: busy flag and address counter
+#define LCD_BUSYFLAG 0x80
+#define LCD_ADDRESSMASK 0x7F
+
+// power-on time of the controller in ms, counted from the MCU reset
+#define LCD_POWER_UP_TIME 50
+// initialisation waits in us after a warm reset: the longest instruction
+// (return home, 1.52ms) and a normal one with margin
+#define LCD_WARM_LONG 1600
+#define LCD_WARM_SHORT 100
+
+// longest a command may keep the busy flag set before polling gives up
+// and the driver falls back to the fixed worst case delays
+#define LCD_BUSY_TIMEOUT 2500
+
+// Queued mode: bytes waiting for the Timer2 interrupt. A full 16x2 screen
+// plus the cursor moves fits in 64 entries.
+#if !defined(LCD_QUEUE_SIZE)
+#if ((RAMEND - RAMSTART) < 1023)
+#define LCD_QUEUE_SIZE 16
+#else
+#define LCD_QUEUE_SIZE 64
+#endif
+#endif
+#if (LCD_QUEUE_SIZE > 256) || (LCD_QUEUE_SIZE % 8)
+#error "LCD_QUEUE_SIZE must be a multiple of 8, at most 256"
+#endif
+
+// interrupt period in us, longer than the 37us a normal instruction needs
+#define LCD_QUEUE_TICK 50
+// DDRAM columns of one line in 2 line mode, the virtual screen width
+#define LCD_LINE_LENGTH 40
+
+// clear and home take up to 1.52ms, hold the queue for this many ticks
+#define LCD_QUEUE_LONG_TICKS (2000 / LCD_QUEUE_TICK)
+
+// 74HC595 backpack: the shift register bits of the LCD lines
+#define LCD_SPI_RS 0x02
+#define LCD_SPI_EN 0x08
+#define LCD_SPI_DATA_SHIFT 4
+// most shift register states needed for one instruction
+#define LCD_SPI_SEQUENCE 5
+// settle time of a normal instruction and of clear/home in us
+#define LCD_SPI_SETTLE 37
+#define LCD_SPI_SETTLE_LONG 1520
+
+// PCF8574 I2C backpack: the expander pins of the LCD lines
+#define LCD_I2C_RS 0x01
+#define LCD_I2C_RW 0x02
+#define LCD_I2C_EN 0x04
+#define LCD_I2C_BL 0x08
+// most expander states needed for one byte
+#define LCD_I2C_SEQUENCE 5
+// expander states buffered for one I2C transaction, 5 per byte: a line
+// of 16 characters goes out in one burst
+#define LCD_I2C_BUFFER 84
+
+// Bus sequencing shared by LiquidCrystal and the LiquidCrystalT transports.
+
+// DDRAM address of a position. Rows 2 and 3 of 4 line displays continue
+// rows 0 and 1 right after the visible columns (0x14 and 0x54 on a 20x4).
+inline uint8_t lcdAddress(uint8_t col, uint8_t row, uint8_t numcols, uint8_t numlines)
+{
+  if (row >= numlines) {
+    row = numlines - 1;    // we count rows starting w/0
+  }
+  if (row > 3) {
+    row = 3;
+  }
+  uint8_t offset = (row & 0x01) ? 0x40 : 0x00;
+  if (row & 0x02) {
+    offset += numcols;
+  }
+  return (col + offset) & 0x7F;
+}
+
+// Build the shift register states that clock the high nibble (and the low
+// one if nibbles is 2) of value into the controller: RS and data with
+// enable low for the setup time, enable high, enable low. The second
+// nibble can go up together with enable, the data only has to be stable
+// before the falling edge. Returns the number of states.
+inline uint8_t lcdSpiSequence(uint8_t *seq, uint8_t value, uint8_t mode, uint8_t nibbles)
+{
+  uint8_t rs = mode ? LCD_SPI_RS : 0;
+  uint8_t state = rs | (value & 0xF0);
+
+  seq[0] = state;
+  seq[1] = state | LCD_SPI_EN;
+  seq[2] = state;
+  if (nibbles == 1) {
+    return 3;
+  }
+
+  state = rs | (uint8_t)(value << LCD_SPI_DATA_SHIFT);
+  seq[3] = state | LCD_SPI_EN;
+  seq[4] = state;
+  return 5;
+}
+
+// Build the expander states that clock the high nibble (and the low one
+// if nibbles is 2) of value into the controller: enable high, enable low
+// for each nibble. A leading state sets RS before enable rises; within a
+// burst it also keeps the previous instruction 2 states (45us at 400kHz)
+// ahead of the next one, more than the 37us it needs to execute. state is
+// the last one sent, with the backlight bit, and is updated. Returns the
+// number of states, at most LCD_I2C_SEQUENCE.
+inline uint8_t lcdI2cSequence(uint8_t *seq, uint8_t &state, bool burst,
+                              uint8_t value, uint8_t mode, uint8_t nibbles)
+{
+  uint8_t next = (state & LCD_I2C_BL) | (mode ? LCD_I2C_RS : 0);
+  uint8_t count = 0;
+
+  if (((next ^ state) & LCD_I2C_RS) || burst) {
+    seq[count++] = next | (value & 0xF0);
+  }
+  for (uint8_t i = 0; i < nibbles; i++) {
+    uint8_t data = next | (i ? (uint8_t)(value << 4) : (value & 0xF0));
+    seq[count++] = data | LCD_I2C_EN;
+    seq[count++] = data;
+  }
+  state = next;
+  return count;
+}
+
+// State of the PCF8574 transport. LiquidCrystalI2C carries it, the
+// other transports only pay for the pointer to it.
+struct LcdI2cState {
+  TwiMasterClass *twi;
+  uint8_t state;                // last state appended, with the backlight bit
+  uint8_t buffer[LCD_I2C_BUFFER];
+  uint8_t length;               // states waiting to be submitted
+  bool batch;                   // collect writes into one transaction
+  TwiTransaction tx;
+  volatile unsigned long done;  // micros() when the last one finished
+  unsigned int settle;          // time its last instruction needs
+};
+
 class LiquidCrystal : public Print {
 public:
 // 11
@@ -65,6 +203,7 @@ public:
 		uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
 // 1
   LiquidCrystal(uint8_t ssPin); //SPI to ShiftRegister 74HC595 ##########
+// 2: I2C to PCF8574, see LiquidCrystalI2C
 
 
   void init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t enable,
@@ -72,9 +211,16 @@ public:
 	    uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7, uint8_t bl);
 		
   void initSPI(uint8_t _ssPin); //SPI ##################################
+  void initI2C(uint8_t address); //I2C ##################################
     
+  // Set up the display. After a power-on reset it waits until 50ms have
+  // passed since reset, after an external or watchdog reset the display
+  // kept running and the 4.1ms initialisation waits are cut short.
   void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
 
+  // the last reset left the display powered, from the core's resetCause()
+  static bool warmStart();
+
   void clear();
   void home();
 
@@ -91,17 +237,73 @@ public:
   void autoscroll();
   void noAutoscroll();
 
+  // Virtual screen on 2 line displays: each DDRAM line holds 40
+  // characters, page n starts at column n * cols. Lay the pages out once
+  // with setPageCursor(), showPage() then moves the display window with
+  // shift commands instead of rewriting the text.
+  uint8_t pages();
+  void setPageCursor(uint8_t page, uint8_t col, uint8_t row);
+  void showPage(uint8_t page);
+
   void createChar(uint8_t, uint8_t[]);
   void backlight(uint8_t);
   void setCursor(uint8_t, uint8_t); 
   virtual size_t write(uint8_t);
+  // runs of characters share one SPI transaction on the backpack
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
   void command(uint8_t);
+
+  // Only with an RW pin wired: the DDRAM/CGRAM address counter once the
+  // controller is ready, 0xFF if it can not be read.
+  uint8_t readAddressCounter();
+
+  // Queued mode, parallel bus only: write() and command() store the byte
+  // and return, a Timer2 compare interrupt clocks it out at the pace of
+  // the controller. Only one display can be queued at a time and tone()
+  // can not be used while it is. Returns false if the queue can not run.
+  bool beginQueue();
+  void endQueue();
+  bool queued() { return _queued; }
+  // wait until every queued byte has reached the display
+  virtual void flush();
+  virtual int availableForWrite();
+  uint8_t queueDepth();
+  uint8_t queuePeak() { return _queue_peak; }           // highest depth seen
+  unsigned int queueStalls() { return _queue_stalls; }  // writes that waited for room
+  void resetQueueStats();
+
+  // Timer2 interrupt: send the next queued byte, public for the ISR only
+  void _queue_tick(void);
+  static void _clock_prescale_changed(uint8_t phase);
+protected:
+  LiquidCrystal(LcdI2cState &state, TwiMasterClass &twi, uint8_t address);
 private:
   void send(uint8_t, uint8_t);
-  void spiSendOut();      // SPI ###########################################
+  void transfer(uint8_t, uint8_t);
+  uint8_t readStatus();
+  void waitReady();
+  void spiBurst(const uint8_t *, uint8_t);
+  void spiWait(); // SPI ##################################################
+  void i2cAppend(uint8_t, uint8_t, uint8_t); // I2C #####################
+  void i2cSubmit() { _i2c_transport->submit(this); }
+  void i2cWait() { _i2c_transport->wait(this); }
+  // The bus side of the PCF8574 transport, LiquidCrystalI2C.cpp. Only
+  // called through _i2c_transport, so the TWI driver is linked into
+  // sketches using the I2C constructor alone.
+  struct I2cTransport {
+    void (*submit)(LiquidCrystal *);
+    void (*wait)(LiquidCrystal *);
+  };
+  static const I2cTransport i2cTwi;
+  static void i2cTwiSubmit(LiquidCrystal *);
+  static void i2cTwiWait(LiquidCrystal *);
+  static void i2cComplete(TwiTransaction *);
   void write4bits(uint8_t);
   void write8bits(uint8_t);
+  void writeBus(uint8_t, uint8_t);
   void pulseEnable();
+  void initPorts(uint8_t);
   
   
   uint8_t _rs_pin; // LOW: command.  HIGH: character.
@@ -109,14 +311,32 @@ private:
   uint8_t _enable_pin; // activated by a HIGH pulse.
   uint8_t _data_pins[8];
   uint8_t _backlight_pin; // backlight pin
+
+  // parallel bus, resolved once in init() instead of on every digitalWrite
+  volatile uint8_t *_rs_out, *_rw_out, *_enable_out;
+  uint8_t _rs_mask, _rw_mask, _enable_mask;
+  volatile uint8_t *_data_out[8];
+  uint8_t _data_mask[8];
+  volatile uint8_t *_bus_out; // all data pins on one port, 0 otherwise
+  volatile uint8_t *_bus_ddr, *_bus_in;
+  uint8_t _bus_mask;          // data pin bits on that port
+  uint8_t _bus_shift;         // d0 bit when the pins are adjacent, else 0xFF
   
   //SPI #####################################################################
-  uint8_t _bitString; //for SPI  bit0=not used, bit1=RS, bit2=RW, bit3=Enable, bits4-7 = DB4-7
+  //shift register: bit0=not used, bit1=RS, bit2=RW, bit3=Enable, bits4-7 = DB4-7
      bool _usingSpi;  //to let send and write functions know we are using SPI 
   uint8_t _latchPin;
-  uint8_t _clockDivider;
-  uint8_t _dataMode;
-  uint8_t _bitOrder;//SPI ####################################################
+  volatile uint8_t *_latch_out;
+  uint8_t _latch_mask;
+  SPISettings _spiSettings;     // built once, reused by every transaction
+  unsigned long _spi_sent;      // micros() of the last instruction
+  unsigned int _spi_settle;     // and how long it takes to execute//SPI ###
+
+  //I2C ####################################################################
+  //expander: P0=RS, P1=RW, P2=Enable, P3=backlight, P4-P7 = DB4-7
+  bool _usingI2c;
+  LcdI2cState *_i2c;            // in the LiquidCrystalI2C, 0 otherwise
+  const I2cTransport *_i2c_transport; //I2C ##############################
   
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
@@ -124,7 +344,46 @@ private:
 
   uint8_t _initialized;
 
+  bool _busyPolling; // RW wired and the busy flag answers, no fixed delays
+
   uint8_t _numlines,_currline;
+  uint8_t _numcols;
+
+  // where the controller's address counter points, 0xFF when unknown or
+  // in CGRAM; lets setCursor() skip commands which would not move it
+  uint8_t _ac;
+  // columns the display window is shifted to the left (0-39), 0xFF when
+  // autoscroll moved it by an unknown amount
+  uint8_t _shift;
+  void trackCommand(uint8_t);
+  void advanceWrite();
+  void advanceAddress(bool);
+  void shiftWindow(bool left);
+
+  // queued mode, ring buffer shared with the Timer2 interrupt
+  bool _queued;
+  volatile bool _queue_running;  // the interrupt is enabled
+  volatile uint8_t _queue_head;
+  volatile uint8_t _queue_tail;
+  volatile uint8_t _queue_hold;  // ticks left before the next byte
+  uint8_t _queue_peak;
+  unsigned int _queue_stalls;
+  uint8_t _queue[LCD_QUEUE_SIZE];
+  uint8_t _queue_rs[LCD_QUEUE_SIZE / 8]; // RS of each entry, 1 = data
+};
+
+// A display on a PCF8574 I2C backpack, LiquidCrystalI2C lcd(TwiMaster,
+// 0x27). The transport state, most of it the 84 byte burst buffer, lives
+// here rather than in every LiquidCrystal.
+class LiquidCrystalI2C : public LiquidCrystal {
+public:
+  // _state is plain data without a constructor, the base fills it in
+  // before the member's own (empty) initialisation runs
+  LiquidCrystalI2C(TwiMasterClass &twi, uint8_t address) :
+    LiquidCrystal(_state, twi, address) {}
+
+private:
+  LcdI2cState _state;
 };
 
 #endif
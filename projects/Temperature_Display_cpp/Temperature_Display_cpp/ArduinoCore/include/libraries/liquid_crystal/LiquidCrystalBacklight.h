@@ -0,0 +1,84 @@
+#ifndef LiquidCrystalBacklight_h
+#define LiquidCrystalBacklight_h
+
+#include <inttypes.h>
+
+// fade steps are taken every this many ms
+#define LCD_BACKLIGHT_TICK 10
+// default duration of a fade over the full range, in ms
+#define LCD_BACKLIGHT_FADE 500
+// ambient light is sampled every this many ms
+#define LCD_BACKLIGHT_AMBIENT_PERIOD 100
+
+// Non-blocking backlight control for a PWM pin. Levels are perceived
+// brightness 0-255, a gamma curve maps them to the PWM duty, so fades
+// look even to the eye.
+//
+// The work is done from the Timer0 compare B interrupt, which comes
+// about once per millisecond next to the millis() overflow. Only one
+// backlight can be driven at a time.
+//
+// Optionally the backlight dims to a floor level after a period without
+// activity(), and scales with the ambient light measured on an ADC
+// channel (a photo resistor divider, higher reading = brighter room).
+// The ADC is only touched from update(), never from the interrupt.
+class LiquidCrystalBacklight {
+public:
+  LiquidCrystalBacklight(uint8_t pin);
+
+  void begin(uint8_t level);
+  void end();
+
+  // Fade to the level in the given time, 0 switches at once.
+  void fadeTo(uint8_t level, unsigned int ms = LCD_BACKLIGHT_FADE);
+  void set(uint8_t level) { fadeTo(level, 0); }
+
+  uint8_t level() { return _level >> 8; }
+  bool fading() { return _target != (_level >> 8); }
+
+  // After 'timeout' ms without activity() fade down to 'floor', timeout
+  // 0 disables it.
+  void setIdle(unsigned long timeout, uint8_t floor, unsigned int ms = LCD_BACKLIGHT_FADE);
+  // User interaction: restart the idle timeout, brighten up if dimmed.
+  void activity();
+  bool idle() { return _idle; }
+
+  // Scale the level between 'dark' (reading 0) and the level set with
+  // fadeTo() (reading 1023). Channel 0xFF disables it.
+  void setAmbient(uint8_t channel, uint8_t dark);
+  // Call from loop() when ambient light is used: every
+  // LCD_BACKLIGHT_AMBIENT_PERIOD ms it takes one analogRead() of the
+  // channel (about 110us), so the ADC is never shared with a conversion
+  // of the sketch.
+  void update();
+
+  // Timer0 interrupt, public for the ISR only
+  void _tick(void);
+
+private:
+  void aim(uint8_t target, unsigned int ms);
+  uint8_t effectiveLevel();
+  void output();
+
+  uint8_t _pin;
+
+  volatile uint16_t _level;  // current level, 8.8 fixed point
+  volatile uint16_t _rate;   // change per tick, 8.8 fixed point
+  volatile uint8_t _target;
+  uint8_t _active;           // level while in use
+  uint8_t _duty;             // last PWM value written
+  unsigned long _lastTick;
+
+  unsigned long _idleTimeout;
+  volatile unsigned long _lastActivity;
+  unsigned int _idleFade;
+  uint8_t _floor;
+  volatile bool _idle;
+
+  uint8_t _channel;
+  uint8_t _dark;
+  volatile uint16_t _ambient; // filtered ADC reading
+  unsigned long _lastSample;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef LiquidCrystalBuffer_h
+#define LiquidCrystalBuffer_h
+
+#include <inttypes.h>
+#include "Print.h"
+
+#include "LiquidCrystal.h"
+
+// The HD44780 holds 80 characters of DDRAM, 2 lines of 40 in 2-line
+// mode (rows 2 and 3 of 4-line displays continue rows 0 and 1), or a
+// single line of 80.
+#define LCD_DDRAM_SIZE 80
+#define LCD_DDRAM_LINE_SIZE 40
+
+// RAM copy of the display DDRAM. Printing goes to the copy only and
+// marks the cells which changed, flush() sends just the changed runs to
+// the display with as few cursor commands as possible.
+//
+// flush() assumes the display is in the default left to right entry
+// mode without autoscroll, and that nothing else wrote to DDRAM since
+// the last flush (call invalidate() if something did).
+class LiquidCrystalBuffer : public Print {
+public:
+  LiquidCrystalBuffer(LiquidCrystal &lcd);
+
+  // Same geometry as passed to LiquidCrystal::begin(). Assumes the
+  // display has just been cleared.
+  void begin(uint8_t cols, uint8_t rows);
+
+  void clear();
+  void home();
+  void setCursor(uint8_t, uint8_t);
+  virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+
+  // Character currently stored for the given cell.
+  uint8_t charAt(uint8_t col, uint8_t row);
+
+  // Forget what the display shows, the next flush() rewrites every cell.
+  void invalidate();
+
+  // Send the changed cells to the display.
+  virtual void flush();
+
+  // Bit n is set if custom character n (or its alias n + 8) is stored
+  // in any cell, shown or still waiting for flush().
+  uint8_t customChars();
+  // The same for what the display showed after the last flush(): a
+  // cell overwritten since still shows its old character. All set after
+  // invalidate().
+  uint8_t shownCustomChars() { return _shown_chars; }
+
+  LiquidCrystal &display() { return _lcd; }
+
+  // Characters and cursor commands sent by the last flush().
+  uint8_t lastFlushChars() { return _flush_chars; }
+  uint8_t lastFlushCommands() { return _flush_commands; }
+
+protected:
+  uint8_t cellIndex(uint8_t col, uint8_t row);
+  uint8_t cellAddress(uint8_t index);
+  void setCell(uint8_t index, uint8_t value);
+  bool isDirty(uint8_t index) { return _dirty[index >> 3] & (1 << (index & 0x07)); }
+
+  LiquidCrystal &_lcd;
+
+  uint8_t _cells[LCD_DDRAM_SIZE];
+  uint8_t _dirty[LCD_DDRAM_SIZE / 8];
+
+  uint8_t _numcols;
+  uint8_t _numlines;
+  uint8_t _cursor; // index of the cell the next write goes to
+
+  uint8_t _flush_chars;
+  uint8_t _flush_commands;
+  uint8_t _shown_chars;
+};
+
+#endif
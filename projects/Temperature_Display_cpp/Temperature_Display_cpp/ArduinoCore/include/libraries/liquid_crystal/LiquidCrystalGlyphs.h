@@ -0,0 +1,55 @@
+#ifndef LiquidCrystalGlyphs_h
+#define LiquidCrystalGlyphs_h
+
+#include <inttypes.h>
+
+#include "LiquidCrystalBuffer.h"
+
+// The HD44780 has 8 user defined characters of 8 rows each.
+#define LCD_CGRAM_SLOTS 8
+#define LCD_GLYPH_SIZE 8
+
+// Keeps track of which bitmaps are loaded in CGRAM, so a glyph is only
+// uploaded when it is not resident yet. On a miss the least recently
+// used slot is replaced, but never one that a cell of the framebuffer
+// or of the display (until the next flush) still refers to, it would
+// change on the display.
+//
+// Glyphs are 8 byte bitmaps in PROGMEM, identified by their address.
+// An upload moves the display address counter into CGRAM, the
+// framebuffer handles that, direct LiquidCrystal users must call
+// setCursor() before writing again.
+class LiquidCrystalGlyphs {
+public:
+  LiquidCrystalGlyphs(LiquidCrystalBuffer &screen);
+
+  // Character code (0-7) showing the glyph, 0xFF if all slots hold
+  // glyphs which are on the display.
+  uint8_t acquire(const uint8_t *glyph);
+
+  // Slot holding the glyph, 0xFF if it is not resident. Does not count
+  // as a use.
+  uint8_t find(const uint8_t *glyph);
+
+  // Forget the CGRAM contents, e.g. after LiquidCrystal::begin().
+  void invalidate();
+
+  LiquidCrystalBuffer &screen() { return _screen; }
+
+  unsigned int hits() { return _hits; }
+  unsigned int uploads() { return _uploads; }
+  void resetStats();
+
+private:
+  void touch(uint8_t slot);
+
+  LiquidCrystalBuffer &_screen;
+
+  const uint8_t *_glyphs[LCD_CGRAM_SLOTS]; // resident glyph of each slot
+  uint8_t _lru[LCD_CGRAM_SLOTS];           // slots, most recently used first
+
+  unsigned int _hits;
+  unsigned int _uploads;
+};
+
+#endif
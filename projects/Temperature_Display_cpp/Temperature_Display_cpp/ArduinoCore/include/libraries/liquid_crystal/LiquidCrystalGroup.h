@@ -0,0 +1,125 @@
+#ifndef LiquidCrystalGroup_h
+#define LiquidCrystalGroup_h
+
+#include <inttypes.h>
+#include "Print.h"
+
+#include "LiquidCrystal.h"
+#include "LiquidCrystalT.h"
+
+// bytes waiting per display, a 16 character line plus a cursor move
+#if !defined(LCD_GROUP_QUEUE)
+#if ((RAMEND - RAMSTART) < 1023)
+#define LCD_GROUP_QUEUE 8
+#else
+#define LCD_GROUP_QUEUE 32
+#endif
+#endif
+
+// what an entry is, and how long the display needs after it
+#define LCD_GROUP_RS     0x01 // data, not an instruction
+#define LCD_GROUP_NIBBLE 0x02 // high nibble only, initialisation
+#define LCD_GROUP_LONG   0x04 // clear and home, 1.52ms
+#define LCD_GROUP_WAKE   0x08 // power-on handshake, 4.1ms
+
+// execution time of a normal and a long instruction in us, with margin
+#define LCD_GROUP_SETTLE 50
+#define LCD_GROUP_SETTLE_LONG 2000
+
+class LiquidCrystalShared;
+
+// HD44780 displays sharing RS and the 4 data lines, each with its own
+// enable line; RW is tied low. A display only latches the bus on its own
+// enable pulse, so while one display executes an instruction the next
+// byte can go to another. Each display queues what is printed to it,
+// poll() sends the next byte of every display that is ready; with n
+// displays a refresh of all of them takes about as long as one.
+//
+//   LiquidCrystalGroup lcds(8, 4, 5, 6, 7);  // rs, d4-d7
+//   LiquidCrystalShared left(lcds, 9);        // enable pins
+//   LiquidCrystalShared right(lcds, 11);
+//
+// The group has to be constructed before its displays.
+class LiquidCrystalGroup {
+public:
+  LiquidCrystalGroup(uint8_t rs, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7);
+
+  // Send one byte to each display that has one queued and is ready.
+  // Returns false once every queue is empty.
+  bool poll();
+  // wait until every queued byte has reached its display
+  void flush();
+
+private:
+  friend class LiquidCrystalShared;
+  void attach(LiquidCrystalShared *display);
+  void transfer(uint8_t value, uint8_t flags, LcdPin &enable);
+  void pulse(LcdPin &enable);
+
+  LcdPin _rs;
+  LcdPin _data[4];
+  LiquidCrystalShared *_displays;
+};
+
+// One display of a LiquidCrystalGroup, the LiquidCrystal API without the
+// parts that need RW. Writes are queued; they go out from poll() and
+// flush() of the group, when the queue runs full, and one at a time as
+// the display becomes ready on each later write.
+class LiquidCrystalShared : public Print {
+public:
+  LiquidCrystalShared(LiquidCrystalGroup &group, uint8_t enable);
+
+  // Queues the initialisation, displays begun one after the other run it
+  // side by side. Waits for the power-on time like LiquidCrystal::begin().
+  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+
+  void clear();
+  void home();
+
+  void noDisplay();
+  void display();
+  void noBlink();
+  void blink();
+  void noCursor();
+  void cursor();
+  void scrollDisplayLeft();
+  void scrollDisplayRight();
+  void leftToRight();
+  void rightToLeft();
+  void autoscroll();
+  void noAutoscroll();
+
+  void createChar(uint8_t, const uint8_t[]);
+  void setCursor(uint8_t, uint8_t);
+  virtual size_t write(uint8_t);
+  using Print::write;
+  void command(uint8_t);
+
+  // wait until the queue of this display is empty, the others are
+  // served meanwhile
+  virtual void flush();
+  virtual int availableForWrite();
+
+private:
+  friend class LiquidCrystalGroup;
+  void send(uint8_t value, uint8_t flags);
+
+  LiquidCrystalGroup &_group;
+  LiquidCrystalShared *_next;
+  LcdPin _enable;
+
+  uint8_t _queue[LCD_GROUP_QUEUE];
+  uint8_t _flags[LCD_GROUP_QUEUE];
+  uint8_t _head;
+  uint8_t _tail;
+  unsigned long _sent;    // micros() of the last byte
+  unsigned int _settle;   // and how long the display needs for it
+
+  uint8_t _displayfunction;
+  uint8_t _displaycontrol;
+  uint8_t _displaymode;
+  uint8_t _numlines;
+  uint8_t _numcols;
+};
+
+#endif
@@ -0,0 +1,476 @@
+#ifndef LiquidCrystalT_h
+#define LiquidCrystalT_h
+
+#include <inttypes.h>
+#include "Arduino.h"
+#include "Print.h"
+
+// command set and backpack wiring
+#include "LiquidCrystal.h"
+
+// LiquidCrystal with the transport chosen at compile time. LiquidCrystal
+// decides between the parallel bus, SPI and I2C on every byte and carries
+// the state of all of them; LiquidCrystalT<Transport> only contains the
+// code and fields of the one it is built with:
+//
+//   LiquidCrystalT<LcdParallel4> lcd(8, 9, 4, 5, 6, 7);  // rs, enable, d4-d7
+//   LiquidCrystalT<LcdParallel8> lcd(8, 9, 0, 1, 2, 3, 4, 5, 6, 7);
+//   LiquidCrystalT<LcdShift595> lcd(10);                  // latch pin
+//   LiquidCrystalT<LcdPcf8574> lcd(0x27);                 // I2C address
+//
+// RW is not used (tied low), the transports wait out the instruction
+// times instead of polling the busy flag. The queue, the address counter
+// model and the virtual pages of LiquidCrystal are not available.
+//
+// A transport provides:
+//   static const uint8_t interface;  LCD_4BITMODE or LCD_8BITMODE
+//   void begin();                    set up the bus
+//   void reset();                    wake-up sequence into that interface
+//   void send(uint8_t value, uint8_t mode, unsigned int settle);
+//                                    one byte, RS = mode; the next one must
+//                                    not start before settle us passed
+//   void write(const uint8_t *buffer, size_t size);   a run of characters
+//   void backlight(uint8_t value);
+
+// execution time of an instruction and of clear/home in us
+#define LCD_EXECUTION_TIME 37
+#define LCD_EXECUTION_TIME_LONG 1520
+
+// One output pin, looked up once. The read-modify-write must not race
+// with interrupt handlers touching the same port.
+struct LcdPin {
+  volatile uint8_t *out;
+  uint8_t mask;
+
+  void attach(uint8_t pin) {
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);  // also turns off PWM on the pin
+    out = portOutputRegister(digitalPinToPort(pin));
+    mask = digitalPinToBitMask(pin);
+  }
+
+  void write(uint8_t value) {
+    uint8_t oldSREG = SREG;
+    cli();
+    if (value) {
+      *out |= mask;
+    } else {
+      *out &= ~mask;
+    }
+    SREG = oldSREG;
+  }
+};
+
+// Figure 24 of the HD44780 datasheet: three times 8-bit mode, then 4-bit,
+// each as a single nibble with RS low
+template <class Bus>
+inline void lcdWake4(Bus &bus)
+{
+  bus.nibble(0x30, 4500); // wait min 4.1ms
+  bus.nibble(0x30, 4500);
+  bus.nibble(0x30, 150);
+  bus.nibble(0x20, LCD_EXECUTION_TIME);
+}
+
+/************ parallel bus, 4 or 8 data lines */
+
+template <uint8_t Width>
+class LcdParallel {
+public:
+  static const uint8_t interface = (Width == 8) ? LCD_8BITMODE : LCD_4BITMODE;
+
+  LcdParallel(uint8_t rs, uint8_t enable,
+              uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) {
+    static_assert(Width == 4, "LcdParallel8 needs 8 data pins");
+    uint8_t data[] = { d0, d1, d2, d3 };
+    attach(rs, enable, data);
+  }
+
+  LcdParallel(uint8_t rs, uint8_t enable,
+              uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
+              uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) {
+    static_assert(Width == 8, "LcdParallel4 takes 4 data pins");
+    uint8_t data[] = { d0, d1, d2, d3, d4, d5, d6, d7 };
+    attach(rs, enable, data);
+  }
+
+  void begin() {
+    _rs.write(LOW);
+    _enable.write(LOW);
+  }
+
+  void reset() {
+    if (Width == 8) {
+      // page 45 figure 23
+      send(LCD_FUNCTIONSET | LCD_8BITMODE, LOW, 4500);
+      send(LCD_FUNCTIONSET | LCD_8BITMODE, LOW, 150);
+      send(LCD_FUNCTIONSET | LCD_8BITMODE, LOW, LCD_EXECUTION_TIME);
+    } else {
+      lcdWake4(*this);
+    }
+  }
+
+  void nibble(uint8_t value, unsigned int settle) {
+    _rs.write(LOW);
+    writeBus(value >> 4);
+    pulse(settle);
+  }
+
+  void send(uint8_t value, uint8_t mode, unsigned int settle) {
+    _rs.write(mode);
+    if (Width == 8) {
+      writeBus(value);
+    } else {
+      writeBus(value >> 4);
+      pulse(0);
+      writeBus(value);
+    }
+    pulse(settle);
+  }
+
+  void write(const uint8_t *buffer, size_t size) {
+    while (size--) {
+      send(*buffer++, HIGH, LCD_EXECUTION_TIME);
+    }
+  }
+
+  // the parallel bus has no backlight line, see LiquidCrystalBacklight
+  void backlight(uint8_t) { }
+
+private:
+  void attach(uint8_t rs, uint8_t enable, const uint8_t *data) {
+    _rs.attach(rs);
+    _enable.attach(enable);
+
+    // the whole nibble (or byte) goes out in one read-modify-write when
+    // the data pins are adjacent bits of one port
+    uint8_t port = digitalPinToPort(data[0]);
+    _bus_shift = 0;
+    while (_bus_shift < 7 && !(digitalPinToBitMask(data[0]) & (1 << _bus_shift))) {
+      _bus_shift++;
+    }
+    _bus_mask = 0;
+    for (uint8_t i = 0; i < Width; i++) {
+      _data[i].attach(data[i]);
+      if ((digitalPinToPort(data[i]) != port) ||
+          (_data[i].mask != (uint8_t)(_data[0].mask << i))) {
+        port = NOT_A_PORT;
+      }
+      _bus_mask |= _data[i].mask;
+    }
+    _bus_out = (port != NOT_A_PORT) ? portOutputRegister(port) : 0;
+  }
+
+  // put the low Width bits of value on the data pins
+  void writeBus(uint8_t value) {
+    if (_bus_out) {
+      uint8_t oldSREG = SREG;
+      cli();
+      *_bus_out = (*_bus_out & ~_bus_mask) | ((value << _bus_shift) & _bus_mask);
+      SREG = oldSREG;
+    } else {
+      for (uint8_t i = 0; i < Width; i++) {
+        _data[i].write((value >> i) & 0x01);
+      }
+    }
+  }
+
+  void pulse(unsigned int settle) {
+    _enable.write(HIGH);
+    delayMicroseconds(1);    // enable pulse must be >450ns
+    _enable.write(LOW);
+    delayMicroseconds(settle);
+  }
+
+  LcdPin _rs;
+  LcdPin _enable;
+  LcdPin _data[Width];
+  volatile uint8_t *_bus_out; // all data pins adjacent on one port, 0 otherwise
+  uint8_t _bus_mask;
+  uint8_t _bus_shift;
+};
+
+typedef LcdParallel<4> LcdParallel4;
+typedef LcdParallel<8> LcdParallel8;
+
+/************ 74HC595 on SPI, see LCD_SPI_RS */
+
+class LcdShift595 {
+public:
+  static const uint8_t interface = LCD_4BITMODE;
+
+  LcdShift595(uint8_t latchPin) : _latch_pin(latchPin), _sent(0), _settle(0) { }
+
+  void begin() {
+    _latch.attach(_latch_pin);
+    _latch.write(HIGH);
+    SPI.begin();
+  }
+
+  void reset() { lcdWake4(*this); }
+
+  void nibble(uint8_t value, unsigned int settle) {
+    uint8_t seq[LCD_SPI_SEQUENCE];
+    transfer(seq, lcdSpiSequence(seq, value, LOW, 1), settle);
+  }
+
+  void send(uint8_t value, uint8_t mode, unsigned int settle) {
+    uint8_t seq[LCD_SPI_SEQUENCE];
+    transfer(seq, lcdSpiSequence(seq, value, mode, 2), settle);
+  }
+
+  // one transaction for the whole run
+  void write(const uint8_t *buffer, size_t size) {
+    uint8_t seq[LCD_SPI_SEQUENCE];
+    SPI.beginTransaction(SPISettings(F_CPU / 2, MSBFIRST, SPI_MODE0));
+    while (size--) {
+      uint8_t count = lcdSpiSequence(seq, *buffer++, HIGH, 2);
+      wait();
+      burst(seq, count);
+    }
+    SPI.endTransaction();
+  }
+
+  void backlight(uint8_t) { }
+
+private:
+  void transfer(const uint8_t *seq, uint8_t count, unsigned int settle) {
+    wait();
+    SPI.beginTransaction(SPISettings(F_CPU / 2, MSBFIRST, SPI_MODE0));
+    burst(seq, count);
+    SPI.endTransaction();
+    _settle = settle;
+  }
+
+  // every state gets its own latch edge
+  void burst(const uint8_t *seq, uint8_t count) {
+    while (count--) {
+      SPI.transfer(*seq++);
+      _latch.write(LOW);
+      _latch.write(HIGH);
+    }
+    _sent = micros();
+    _settle = LCD_EXECUTION_TIME;
+  }
+
+  // until the last instruction has executed
+  void wait() {
+    while (micros() - _sent < _settle) {
+      ;
+    }
+  }
+
+  uint8_t _latch_pin;
+  LcdPin _latch;
+  unsigned long _sent;    // micros() of the last instruction
+  unsigned int _settle;   // and how long it takes to execute
+};
+
+/************ PCF8574 on I2C, see LCD_I2C_RS */
+
+class LcdPcf8574 {
+public:
+  static const uint8_t interface = LCD_4BITMODE;
+
+  LcdPcf8574(uint8_t address) :
+    _state(LCD_I2C_BL), _length(0), _done(0), _settle(0)
+  {
+    _tx.address = address;
+    _tx.rxData = 0;
+    _tx.rxLength = 0;
+    _tx.callback = complete;
+    _tx.context = this;
+    _tx.status = TWI_OK;
+  }
+
+  void begin() {
+    // the PCF8574 is specified up to 100kHz, most handle 400kHz
+    TwiMaster.begin(TWI_FREQ_FAST);
+  }
+
+  void reset() { lcdWake4(*this); }
+
+  void nibble(uint8_t value, unsigned int settle) {
+    append(value, LOW, 1);
+    submit(settle);
+  }
+
+  void send(uint8_t value, uint8_t mode, unsigned int settle) {
+    append(value, mode, 2);
+    submit(settle);
+  }
+
+  // as few transactions as the buffer allows
+  void write(const uint8_t *buffer, size_t size) {
+    while (size--) {
+      append(*buffer++, HIGH, 2);
+    }
+    submit(LCD_EXECUTION_TIME);
+  }
+
+  // the backpack switches it on or off only
+  void backlight(uint8_t value) {
+    _state = value ? (_state | LCD_I2C_BL) : (_state & ~LCD_I2C_BL);
+    wait();
+    _buffer[_length++] = _state;
+    submit(0);
+  }
+
+private:
+  // the states of a byte or nibble, see lcdI2cSequence()
+  void append(uint8_t value, uint8_t mode, uint8_t nibbles) {
+    if (_length + LCD_I2C_SEQUENCE > LCD_I2C_BUFFER) {
+      submit(LCD_EXECUTION_TIME);
+    }
+    if (_length == 0) {
+      wait(); // the buffer is still on the bus
+    }
+    _length += lcdI2cSequence(&_buffer[_length], _state, _length != 0, value, mode, nibbles);
+  }
+
+  void submit(unsigned int settle) {
+    if (_length == 0) {
+      return;
+    }
+    _tx.txData = _buffer;
+    _tx.txLength = _length;
+    TwiMaster.submit(&_tx);
+    _length = 0;
+    _settle = settle;
+  }
+
+  // until the last transaction finished and its last instruction executed
+  void wait() {
+    TwiMaster.wait(&_tx);
+    while (micros() - _done < _settle) {
+      ;
+    }
+  }
+
+  static void complete(TwiTransaction *transaction) {
+    ((LcdPcf8574 *)transaction->context)->_done = micros();
+  }
+
+  uint8_t _state;           // last state appended, with the backlight bit
+  uint8_t _buffer[LCD_I2C_BUFFER];
+  uint8_t _length;          // states waiting to be submitted
+  TwiTransaction _tx;
+  volatile unsigned long _done; // micros() when the last one finished
+  unsigned int _settle;     // time its last instruction needs
+};
+
+/************ the display */
+
+template <class Transport>
+class LiquidCrystalT : public Print {
+public:
+  // the arguments go to the transport constructor
+  template <typename... Args>
+  LiquidCrystalT(Args... args) : _bus(args...) { }
+
+  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+
+  void clear() { command(LCD_CLEARDISPLAY); }
+  void home() { command(LCD_RETURNHOME); }
+
+  void noDisplay() { control(_displaycontrol & ~LCD_DISPLAYON); }
+  void display() { control(_displaycontrol | LCD_DISPLAYON); }
+  void noBlink() { control(_displaycontrol & ~LCD_BLINKON); }
+  void blink() { control(_displaycontrol | LCD_BLINKON); }
+  void noCursor() { control(_displaycontrol & ~LCD_CURSORON); }
+  void cursor() { control(_displaycontrol | LCD_CURSORON); }
+  void scrollDisplayLeft() { command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT); }
+  void scrollDisplayRight() { command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT); }
+  void leftToRight() { entryMode(_displaymode | LCD_ENTRYLEFT); }
+  void rightToLeft() { entryMode(_displaymode & ~LCD_ENTRYLEFT); }
+  void autoscroll() { entryMode(_displaymode | LCD_ENTRYSHIFTINCREMENT); }
+  void noAutoscroll() { entryMode(_displaymode & ~LCD_ENTRYSHIFTINCREMENT); }
+
+  void createChar(uint8_t, const uint8_t[]);
+  void backlight(uint8_t value) { _bus.backlight(value); }
+  void setCursor(uint8_t, uint8_t);
+
+  virtual size_t write(uint8_t value) {
+    _bus.send(value, HIGH, LCD_EXECUTION_TIME);
+    return 1;
+  }
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    _bus.write(buffer, size);
+    return size;
+  }
+  using Print::write;
+
+  // clear and home (0x01-0x03) take the long execution time
+  void command(uint8_t value) {
+    _bus.send(value, LOW, (value & 0xFC) ? LCD_EXECUTION_TIME : LCD_EXECUTION_TIME_LONG);
+  }
+
+  Transport &transport() { return _bus; }
+
+private:
+  void control(uint8_t value) {
+    _displaycontrol = value;
+    command(LCD_DISPLAYCONTROL | value);
+  }
+  void entryMode(uint8_t value) {
+    _displaymode = value;
+    command(LCD_ENTRYMODESET | value);
+  }
+
+  Transport _bus;
+
+  uint8_t _displayfunction;
+  uint8_t _displaycontrol;
+  uint8_t _displaymode;
+  uint8_t _numlines;
+  uint8_t _numcols;
+};
+
+template <class Transport>
+void LiquidCrystalT<Transport>::begin(uint8_t cols, uint8_t lines, uint8_t dotsize)
+{
+  _displayfunction = Transport::interface | LCD_1LINE | LCD_5x8DOTS;
+  if (lines > 1) {
+    _displayfunction |= LCD_2LINE;
+  }
+  // for some 1 line displays you can select a 10 pixel high font
+  if ((dotsize != 0) && (lines == 1)) {
+    _displayfunction |= LCD_5x10DOTS;
+  }
+  _numlines = lines;
+  _numcols = cols;
+
+  _bus.begin();
+
+  // at least 40ms after power rises above 2.7V
+  delayMicroseconds(50000);
+  _bus.reset();
+
+  // finally, set # lines, font size, etc.
+  command(LCD_FUNCTIONSET | _displayfunction);
+
+  // turn the display on with no cursor or blinking default
+  control(LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF);
+  clear();
+
+  // Initialize to default text direction (for romance languages)
+  entryMode(LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT);
+}
+
+template <class Transport>
+void LiquidCrystalT<Transport>::setCursor(uint8_t col, uint8_t row)
+{
+  command(LCD_SETDDRAMADDR | lcdAddress(col, row, _numcols, _numlines));
+}
+
+// Allows us to fill the first 8 CGRAM locations with custom characters,
+// in one run
+template <class Transport>
+void LiquidCrystalT<Transport>::createChar(uint8_t location, const uint8_t charmap[])
+{
+  location &= 0x7; // we only have 8 locations 0-7
+  command(LCD_SETCGRAMADDR | (location << 3));
+  _bus.write(charmap, 8);
+}
+
+#endif
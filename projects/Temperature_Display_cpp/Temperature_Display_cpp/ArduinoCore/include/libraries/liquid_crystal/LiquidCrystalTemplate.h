@@ -0,0 +1,73 @@
+#ifndef LiquidCrystalTemplate_h
+#define LiquidCrystalTemplate_h
+
+#include <inttypes.h>
+
+#include "LiquidCrystalBuffer.h"
+
+// most fields one template can hold
+#define LCD_TEMPLATE_FIELDS 8
+// widest field: sign, 10 digits of a long and the decimal point
+#define LCD_TEMPLATE_FIELD_WIDTH 12
+
+// marks a digit position of a field in the template text
+#define LCD_TEMPLATE_DIGIT '#'
+
+// A screen layout kept in flash: the text of each row, rows separated
+// by '\n', with runs of '#' where numbers go. A '.' between two '#' is
+// the decimal point of that field. Rows may be up to 40 characters wide
+// to lay out the pages of LiquidCrystal::showPage():
+//
+//   const char layout[] PROGMEM =
+//     "Hum:  ###.# %\n"
+//     "Temp: ###.# *C";
+//
+// show() draws the labels once, set() then renders a reading into the
+// cells of its field only. Everything goes to the framebuffer, so
+// characters which did not change never reach the display.
+//
+// A field is named by a lowercase letter right after its first '#',
+// where it takes the place of a digit:
+//
+//   "Hum:  #h#.# %\n"
+//   "Temp: #t#.# *C"
+//
+// set('h', 451) then finds the field wherever the text puts it. A tag
+// has to be followed by a '#' or the decimal point, "#min" is a one
+// digit field and the label "min". Fields are also numbered 0, 1, ...
+// in the order they appear, row by row and left to right, for layouts
+// without tags.
+class LiquidCrystalTemplate {
+public:
+  LiquidCrystalTemplate(LiquidCrystalBuffer &buffer);
+
+  // Clear the screen and draw the labels of a PROGMEM template, the
+  // fields stay blank until set. Returns the number of fields.
+  uint8_t show(const char *layout);
+
+  // Right aligned value / 10^fraction of the field, dashes if it does
+  // not fit. The field is its tag or its number, a field the layout does
+  // not have is ignored.
+  void set(uint8_t field, long value);
+  // Dashes, for a reading which failed.
+  void setUnknown(uint8_t field);
+
+  uint8_t fields() { return _count; }
+
+private:
+  struct Field {
+    uint8_t col, row;
+    uint8_t width;    // cells, the decimal point included
+    uint8_t fraction; // digits after the decimal point
+    char tag;         // 0 without one
+  };
+
+  const Field *find(uint8_t field);
+  void fill(const Field &f, char c);
+
+  LiquidCrystalBuffer &_buffer;
+  Field _fields[LCD_TEMPLATE_FIELDS];
+  uint8_t _count;
+};
+
+#endif
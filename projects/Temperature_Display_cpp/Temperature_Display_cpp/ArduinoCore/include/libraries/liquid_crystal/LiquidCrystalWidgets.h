@@ -0,0 +1,64 @@
+#ifndef LiquidCrystalWidgets_h
+#define LiquidCrystalWidgets_h
+
+#include <inttypes.h>
+
+#include "LiquidCrystalGlyphs.h"
+
+// The widgets draw into the framebuffer, so only cells which changed
+// reach the display on the next flush(). Their custom characters come
+// from one fixed PROGMEM glyph set shared through the glyph cache: 3
+// for the numerals, 4 for the bar, of which the bar needs one at a time.
+
+// widest number, in digits
+#define LCD_BIGNUMBER_DIGITS 5
+// columns of one large digit, another one separates them
+#define LCD_BIGNUMBER_WIDTH 3
+
+// Numerals two rows high and 3 columns wide, right aligned. The column
+// between two digits holds the decimal point.
+class LiquidCrystalBigNumber {
+public:
+  // 'digits' positions (a minus sign takes one) starting at col/row,
+  // the last 'fraction' of them after the decimal point. Needs
+  // 4 * digits - 1 columns.
+  LiquidCrystalBigNumber(LiquidCrystalGlyphs &glyphs, uint8_t col, uint8_t row,
+                         uint8_t digits, uint8_t fraction = 0);
+
+  // Show value / 10^fraction, dashes if it does not fit.
+  void show(long value);
+
+  // Redraw everything on the next show(), e.g. after the screen was cleared.
+  void invalidate();
+
+private:
+  void drawChar(uint8_t pos, char c);
+  uint8_t cellChar(uint8_t code);
+
+  LiquidCrystalGlyphs &_glyphs;
+  uint8_t _col, _row;
+  uint8_t _digits, _fraction;
+  char _shown[LCD_BIGNUMBER_DIGITS]; // characters on the display, 0 unknown
+};
+
+// Horizontal bar on one row, 5 steps per character cell.
+class LiquidCrystalBar {
+public:
+  LiquidCrystalBar(LiquidCrystalGlyphs &glyphs, uint8_t col, uint8_t row,
+                   uint8_t width);
+
+  // Fill value / max of the bar.
+  void show(unsigned int value, unsigned int max);
+
+  void invalidate();
+
+private:
+  void drawCell(uint8_t cell, unsigned int steps);
+
+  LiquidCrystalGlyphs &_glyphs;
+  uint8_t _col, _row;
+  uint8_t _width;
+  unsigned int _steps; // filled steps on the display, 0xFFFF unknown
+};
+
+#endif
@@ -202,6 +202,10 @@ public:
 
     SPCR = settings.spcr;
     SPSR = settings.spsr;
+    // SPISettings are computed for F_CPU, speed the divider up when the
+    // system clock is divided at runtime
+    clockSetting = clockBits(settings.spcr, settings.spsr);
+    if (clockShift) rescaleClock();
   }
 
   // Write to the SPI bus (MOSI pin) and also receive (MISO pin)
@@ -302,6 +306,8 @@ public:
   inline static void setClockDivider(uint8_t clockDiv) {
     SPCR = (SPCR & ~SPI_CLOCK_MASK) | (clockDiv & SPI_CLOCK_MASK);
     SPSR = (SPSR & ~SPI_2XCLOCK_MASK) | ((clockDiv >> 2) & SPI_2XCLOCK_MASK);
+    clockSetting = clockBits(SPCR, SPSR);
+    if (clockShift) rescaleClock();
   }
   // These undocumented functions should not be used.  SPI.transfer()
   // polls the hardware flag which is automatically cleared as the
@@ -309,7 +315,22 @@ public:
   inline static void attachInterrupt() { SPCR |= _BV(SPIE); }
   inline static void detachInterrupt() { SPCR &= ~_BV(SPIE); }
 
+  // Clock prescaler handler, registered by begin(). Keeps the SCK
+  // frequency when setClockPrescale() divides the system clock.
+  static void clockPrescaleChanged(uint8_t phase);
+
 private:
+  // SCK divider as SPR1, SPR0 and the inverted SPI2X bit, see SPISettings
+  inline static uint8_t clockBits(uint8_t spcr, uint8_t spsr) {
+    return ((spcr & SPI_CLOCK_MASK) << 1) | (~spsr & SPI_2XCLOCK_MASK);
+  }
+  // Program clockSetting made clockShift powers of two smaller, clamped
+  // to fosc/2..fosc/128. Always computed from the setting, so clamping
+  // does not stick when the system clock is restored.
+  static void rescaleClock();
+
+  static uint8_t clockSetting; // SCK divider requested for F_CPU, clockBits()
+  static uint8_t clockShift; // system clock prescale the divider is adjusted for
   static uint8_t initialized;
   static uint8_t interruptMode; // 0=none, 1=mask, 2=global
   static uint8_t interruptMask; // which interrupts to mask
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018 by Krzysztof Wisniewski
+ * Interrupt driven TWI (I2C) master for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _TWI_H_INCLUDED
+#define _TWI_H_INCLUDED
+
+#include <Arduino.h>
+
+#define TWI_FREQ_STANDARD 100000L
+#define TWI_FREQ_FAST     400000L
+
+// times a transaction is restarted after losing arbitration
+#define TWI_ARBITRATION_RETRIES 3
+// poll() gives up on a transaction running longer than this, in ms
+#define TWI_TIMEOUT 25
+
+// transaction status
+#define TWI_PENDING          0  // queued or on the bus
+#define TWI_OK               1
+#define TWI_NACK_ADDRESS     2  // no device answered
+#define TWI_NACK_DATA        3  // the device refused a byte
+#define TWI_ARBITRATION_LOST 4  // another master kept winning
+#define TWI_BUS_ERROR        5  // illegal START/STOP on the bus
+#define TWI_TIMEOUT_ERROR    6  // the bus hung, see poll()
+
+struct TwiTransaction;
+typedef void (*TwiCallback)(TwiTransaction *transaction);
+
+// One transfer with a 7 bit address device. With txLength only it is a
+// write, with rxLength only a read, with both the bytes are written and
+// then read after a repeated START. The caller owns the memory and must
+// keep it, and the data buffers, untouched while status is TWI_PENDING.
+struct TwiTransaction {
+  uint8_t address;
+  const uint8_t *txData;
+  uint8_t txLength;
+  uint8_t *rxData;
+  uint8_t rxLength;
+  // called from the interrupt handler when the transaction finished,
+  // may submit the next one (or this one again), which goes out right
+  // after the STOP
+  TwiCallback callback;
+  void *context;
+
+  volatile uint8_t status;
+  TwiTransaction *next;  // queue link, used by the driver
+};
+
+// The bus work runs entirely in the TWI interrupt: submit() only queues
+// a transaction and returns, completion is reported in the status field
+// and through the callback. Transactions run one after another in
+// submission order, a STOP and the next START are issued together.
+class TwiMasterClass {
+public:
+  // Enable the TWI on SDA/SCL at the given bus frequency. A device left
+  // in the middle of a read from a previous run is clocked free first.
+  static void begin(uint32_t frequency = TWI_FREQ_STANDARD);
+  static void end();
+  static void setClock(uint32_t frequency);
+
+  // Queue a transaction. False if it is already queued.
+  static bool submit(TwiTransaction *transaction);
+
+  static bool busy() { return queueHead != 0; }
+
+  // Block until the transaction finished. With interrupts disabled the
+  // state machine is run from here, like HardwareSerial::flush() does.
+  static void wait(TwiTransaction *transaction);
+
+  // Call from the main loop from time to time. Fails the running
+  // transaction and frees the bus if it got stuck, e.g. a device holding
+  // SCL low. The interrupt alone can not detect that.
+  static void poll();
+
+  // Clock SCL until a device holding SDA low lets go and send a STOP.
+  static void recover();
+
+  // State machine step for the status in TWSR, returns the value for
+  // TWCR. The data register is passed in, so the only hardware access
+  // is the caller's: the ISR passes TWDR, the host tests the register of
+  // a simulated peripheral (tests/twi). Public for the ISR only.
+  static uint8_t step(uint8_t status, volatile uint8_t &data);
+
+  static void clockPrescaleChanged(uint8_t phase);
+
+private:
+  static uint8_t startNext();
+  static void complete(uint8_t status);
+  static uint8_t finish(uint8_t status);
+
+  static TwiTransaction * volatile queueHead;
+  static TwiTransaction *queueTail;
+  static uint32_t frequency;
+  static uint8_t index;       // byte of the current phase
+  static uint8_t reading;     // in the read phase of the current transaction
+  static uint8_t retries;
+  static bool completing;     // in a callback, submit() must not touch TWCR
+  static unsigned long started;
+};
+
+extern TwiMasterClass TwiMaster;
+
+#endif
@@ -0,0 +1,101 @@
+/*
+  BufferedPrint.cpp - Write-combining adapter for Print
+  Copyright (c) 2018 Krzysztof Wisniewski.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "BufferedPrint.h"
+
+BufferedPrint::BufferedPrint(Print &out, bool flushOnNewline) :
+  _out(out), _flushOnNewline(flushOnNewline), _length(0)
+{
+}
+
+size_t BufferedPrint::write(uint8_t c)
+{
+  _buffer[_length++] = c;
+  if (_length == sizeof(_buffer) || (c == '\n' && _flushOnNewline)) {
+    // c is the last byte, the first one lost on a short write
+    if (drain()) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+size_t BufferedPrint::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = size;
+
+  while (n) {
+    // a run at least as long as the buffer goes on directly
+    if (_length == 0 && n >= sizeof(_buffer)) {
+      size_t sent = _out.write(buffer, n);
+      if (sent < n) {
+        setWriteError();
+      }
+      return size - n + sent;
+    }
+
+    uint8_t room = sizeof(_buffer) - _length;
+    uint8_t count = n < room ? n : room;
+    memcpy(&_buffer[_length], buffer, count);
+    _length += count;
+    buffer += count;
+    n -= count;
+
+    if (_length == sizeof(_buffer) ||
+        (_flushOnNewline && memchr(buffer - count, '\n', count))) {
+      // the bytes of this call are at the end of the buffer, they are
+      // lost first
+      uint8_t lost = drain();
+      if (lost) {
+        return size - n - (lost < count ? lost : count);
+      }
+    }
+  }
+  return size;
+}
+
+bool BufferedPrint::send()
+{
+  return drain() == 0;
+}
+
+void BufferedPrint::flush()
+{
+  send();
+  _out.flush();
+}
+
+// Pass the buffer on, returns how many bytes from its end the target
+// did not take. Those are dropped, retrying could block for good.
+uint8_t BufferedPrint::drain()
+{
+  uint8_t lost = 0;
+
+  if (_length) {
+    size_t sent = _out.write(_buffer, _length);
+    if (sent < _length) {
+      lost = _length - sent;
+      setWriteError();
+    }
+    _length = 0;
+  }
+  return lost;
+}
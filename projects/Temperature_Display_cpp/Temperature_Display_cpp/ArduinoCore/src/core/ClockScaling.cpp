@@ -0,0 +1,109 @@
+/*
+  ClockScaling.cpp - Dynamic system clock scaling for Wiring
+  Copyright (c) 2018 Krzysztof Wisniewski.  All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "Arduino.h"
+#include "ClockScaling.h"
+
+ClockScalingClass ClockScaling;
+
+ClockScalingClass::ClockScalingClass() :
+  _idle(clock_div_1), _current(clock_div_1), _since(0)
+{
+  memset(_requests, 0, sizeof(_requests));
+  memset(_time, 0, sizeof(_time));
+}
+
+// Public Methods //////////////////////////////////////////////////////////////
+
+void ClockScalingClass::begin(uint8_t idleDiv)
+{
+  if (idleDiv >= CLOCK_SCALING_LEVELS)
+    idleDiv = CLOCK_SCALING_LEVELS - 1;
+
+  _idle = idleDiv;
+  _current = getClockPrescale();
+  _since = micros();
+  apply();
+}
+
+void ClockScalingClass::request(uint8_t maxDiv)
+{
+  if (maxDiv >= CLOCK_SCALING_LEVELS)
+    return;
+
+  if (_requests[maxDiv] < 255)
+    _requests[maxDiv]++;
+  apply();
+}
+
+void ClockScalingClass::release(uint8_t maxDiv)
+{
+  if (maxDiv >= CLOCK_SCALING_LEVELS || _requests[maxDiv] == 0)
+    return;
+
+  _requests[maxDiv]--;
+  apply();
+}
+
+unsigned long ClockScalingClass::timeAt(uint8_t div)
+{
+  if (div >= CLOCK_SCALING_LEVELS)
+    return 0;
+
+  account();
+  return _time[div];
+}
+
+void ClockScalingClass::resetStats()
+{
+  memset(_time, 0, sizeof(_time));
+  _since = micros();
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+// Add the time spent at the current division since the last call,
+// whole milliseconds only, the remainder is carried in _since
+void ClockScalingClass::account()
+{
+  unsigned long elapsed = (micros() - _since) / 1000;
+
+  _time[_current] += elapsed;
+  _since += elapsed * 1000;
+}
+
+// Switch to the slowest clock that satisfies all the pending requests
+void ClockScalingClass::apply()
+{
+  uint8_t div = _idle;
+
+  for (uint8_t i = 0; i < _idle; i++) {
+    if (_requests[i]) {
+      div = i;
+      break;
+    }
+  }
+
+  if (div == _current)
+    return;
+
+  account();
+  setClockPrescale(div);
+  _current = div;
+}
@@ -43,21 +43,25 @@
 #if defined(HAVE_HWSERIAL0)
   void serialEvent() __attribute__((weak));
   bool Serial0_available() __attribute__((weak));
+  void Serial0_clock_prescale_changed(uint8_t) __attribute__((weak));
 #endif
 
 #if defined(HAVE_HWSERIAL1)
   void serialEvent1() __attribute__((weak));
   bool Serial1_available() __attribute__((weak));
+  void Serial1_clock_prescale_changed(uint8_t) __attribute__((weak));
 #endif
 
 #if defined(HAVE_HWSERIAL2)
   void serialEvent2() __attribute__((weak));
   bool Serial2_available() __attribute__((weak));
+  void Serial2_clock_prescale_changed(uint8_t) __attribute__((weak));
 #endif
 
 #if defined(HAVE_HWSERIAL3)
   void serialEvent3() __attribute__((weak));
   bool Serial3_available() __attribute__((weak));
+  void Serial3_clock_prescale_changed(uint8_t) __attribute__((weak));
 #endif
 
 void serialEventRun(void)
@@ -76,6 +80,23 @@ void serialEventRun(void)
 #endif
 }
 
+// Called by setClockPrescale() for every UART linked into the sketch
+static void serialClockPrescaleRun(uint8_t phase)
+{
+#if defined(HAVE_HWSERIAL0)
+  if (Serial0_clock_prescale_changed) Serial0_clock_prescale_changed(phase);
+#endif
+#if defined(HAVE_HWSERIAL1)
+  if (Serial1_clock_prescale_changed) Serial1_clock_prescale_changed(phase);
+#endif
+#if defined(HAVE_HWSERIAL2)
+  if (Serial2_clock_prescale_changed) Serial2_clock_prescale_changed(phase);
+#endif
+#if defined(HAVE_HWSERIAL3)
+  if (Serial3_clock_prescale_changed) Serial3_clock_prescale_changed(phase);
+#endif
+}
+
 // Actual interrupt handlers //////////////////////////////////////////////////////////////
 
 void HardwareSerial::_tx_udr_empty_irq(void)
@@ -102,24 +123,7 @@ void HardwareSerial::_tx_udr_empty_irq(void)
 
 void HardwareSerial::begin(unsigned long baud, byte config)
 {
-  // Try u2x mode first
-  uint16_t baud_setting = (F_CPU / 4 / baud - 1) / 2;
-  *_ucsra = 1 << U2X0;
-
-  // hardcoded exception for 57600 for compatibility with the bootloader
-  // shipped with the Duemilanove and previous boards and the firmware
-  // on the 8U2 on the Uno and Mega 2560. Also, The baud_setting cannot
-  // be > 4095, so switch back to non-u2x mode if the baud rate is too
-  // low.
-  if (((F_CPU == 16000000UL) && (baud == 57600)) || (baud_setting >4095))
-  {
-    *_ucsra = 0;
-    baud_setting = (F_CPU / 8 / baud - 1) / 2;
-  }
-
-  // assign the baud_setting, a.k.a. ubrr (USART Baud Rate Register)
-  *_ubrrh = baud_setting >> 8;
-  *_ubrrl = baud_setting;
+  _set_baud_rate(baud);
 
   _written = false;
 
@@ -133,6 +137,8 @@ void HardwareSerial::begin(unsigned long baud, byte config)
   sbi(*_ucsrb, TXEN0);
   sbi(*_ucsrb, RXCIE0);
   cbi(*_ucsrb, UDRIE0);
+
+  attachClockPrescaleHandler(serialClockPrescaleRun);
 }
 
 void HardwareSerial::end()
@@ -210,6 +216,20 @@ void HardwareSerial::flush()
   // the hardware finished tranmission (TXC is set).
 }
 
+void HardwareSerial::_clock_prescale_changed(uint8_t phase)
+{
+  // the UART is not running, nothing to adjust
+  if (bit_is_clear(*_ucsrb, TXEN0))
+    return;
+
+  if (phase == CLOCK_PRESCALE_BEFORE) {
+    // a byte shifted out across the switch would be garbled
+    flush();
+  } else {
+    _set_baud_rate(_baud);
+  }
+}
+
 size_t HardwareSerial::write(uint8_t c)
 {
   _written = true;
@@ -247,4 +267,89 @@ size_t HardwareSerial::write(uint8_t c)
   return 1;
 }
 
+// Copies as much as fits into the ring buffer in one go, publishes it and
+// enables the interrupt once; only waits while the buffer is full.
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if (size == 0)
+    return 0;
+  _written = true;
+
+  size_t n = size;
+  // same shortcut as write(uint8_t) for the first byte
+  if (_tx_buffer_head == _tx_buffer_tail && bit_is_set(*_ucsra, UDRE0)) {
+    *_udr = *buffer++;
+    sbi(*_ucsra, TXC0);
+    n--;
+  }
+
+  while (n) {
+    // only the interrupt handler moves the tail
+#if (SERIAL_TX_BUFFER_SIZE>256)
+    uint8_t tailSREG = SREG;
+    cli();
+#endif
+    tx_buffer_index_t tail = _tx_buffer_tail;
+#if (SERIAL_TX_BUFFER_SIZE>256)
+    SREG = tailSREG;
+#endif
+    tx_buffer_index_t head = _tx_buffer_head;
+    tx_buffer_index_t room = (tail > head) ? tail - head - 1
+                                           : SERIAL_TX_BUFFER_SIZE - 1 - head + tail;
+
+    if (room == 0) {
+      // full, see write(uint8_t)
+      if (bit_is_clear(SREG, SREG_I) && bit_is_set(*_ucsra, UDRE0))
+        _tx_udr_empty_irq();
+      continue;
+    }
+
+    if (room > n)
+      room = n;
+    n -= room;
+    // the handler stops at the head, so the bytes can go in unprotected
+    while (room--) {
+      _tx_buffer[head] = *buffer++;
+      if (++head == SERIAL_TX_BUFFER_SIZE)
+        head = 0;
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+    _tx_buffer_head = head;
+    sbi(*_ucsrb, UDRIE0);
+    SREG = oldSREG;
+  }
+
+  return size;
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+void HardwareSerial::_set_baud_rate(unsigned long baud)
+{
+  unsigned long clock = getClockFrequency();
+
+  _baud = baud;
+
+  // Try u2x mode first
+  uint16_t baud_setting = (clock / 4 / baud - 1) / 2;
+  *_ucsra = 1 << U2X0;
+
+  // hardcoded exception for 57600 for compatibility with the bootloader
+  // shipped with the Duemilanove and previous boards and the firmware
+  // on the 8U2 on the Uno and Mega 2560. Also, The baud_setting cannot
+  // be > 4095, so switch back to non-u2x mode if the baud rate is too
+  // low.
+  if (((clock == 16000000UL) && (baud == 57600)) || (baud_setting >4095))
+  {
+    *_ucsra = 0;
+    baud_setting = (clock / 8 / baud - 1) / 2;
+  }
+
+  // assign the baud_setting, a.k.a. ubrr (USART Baud Rate Register)
+  *_ubrrh = baud_setting >> 8;
+  *_ubrrl = baud_setting;
+}
+
 #endif // whole file
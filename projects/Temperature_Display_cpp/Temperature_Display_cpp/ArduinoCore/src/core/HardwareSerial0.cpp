@@ -76,4 +76,10 @@ bool Serial0_available() {
   return Serial.available();
 }
 
+// Function that can be weakly referenced by serialClockPrescaleRun to
+// prevent pulling in this file if it's not otherwise used.
+void Serial0_clock_prescale_changed(uint8_t phase) {
+  Serial._clock_prescale_changed(phase);
+}
+
 #endif // HAVE_HWSERIAL0
@@ -66,4 +66,10 @@ bool Serial1_available() {
   return Serial1.available();
 }
 
+// Function that can be weakly referenced by serialClockPrescaleRun to
+// prevent pulling in this file if it's not otherwise used.
+void Serial1_clock_prescale_changed(uint8_t phase) {
+  Serial1._clock_prescale_changed(phase);
+}
+
 #endif // HAVE_HWSERIAL1
@@ -54,4 +54,10 @@ bool Serial2_available() {
   return Serial2.available();
 }
 
+// Function that can be weakly referenced by serialClockPrescaleRun to
+// prevent pulling in this file if it's not otherwise used.
+void Serial2_clock_prescale_changed(uint8_t phase) {
+  Serial2._clock_prescale_changed(phase);
+}
+
 #endif // HAVE_HWSERIAL2
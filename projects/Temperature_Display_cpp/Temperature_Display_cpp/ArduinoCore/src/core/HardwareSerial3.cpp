@@ -54,4 +54,10 @@ bool Serial3_available() {
   return Serial3.available();
 }
 
+// Function that can be weakly referenced by serialClockPrescaleRun to
+// prevent pulling in this file if it's not otherwise used.
+void Serial3_clock_prescale_changed(uint8_t phase) {
+  Serial3._clock_prescale_changed(phase);
+}
+
 #endif // HAVE_HWSERIAL3
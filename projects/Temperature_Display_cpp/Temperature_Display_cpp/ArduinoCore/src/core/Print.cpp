@@ -28,6 +28,117 @@
 
 #include "Print.h"
 
+// Number formatting //////////////////////////////////////////////////////////
+
+// These fill a buffer backwards from 'str' and return the first
+// character, so a sign can go in front and the result leaves in a
+// single write().
+
+// 16 bits at a time: x / 10 == (x * 0xCCCD) >> 19 for every 16-bit x,
+// a multiply instead of a call to the 32-bit division routine
+static char *formatDecimal16(char *str, uint16_t n, uint8_t digits)
+{
+  do {
+    uint16_t q = ((uint32_t)n * 0xCCCD) >> 19;
+    *--str = '0' + (n - q * 10);
+    n = q;
+    if (digits) digits--;
+  } while (digits || n);
+  return str;
+}
+
+// at least 'digits' digits, with leading zeros
+static char *formatDecimal(char *str, unsigned long n, uint8_t digits = 1)
+{
+  // split off the low 4 digits with one 32-bit division while n does
+  // not fit 16 bits, at most twice
+  while (n > 0xFFFF || digits > 4) {
+    unsigned long q = n / 10000;
+    str = formatDecimal16(str, n - q * 10000, 4);
+    n = q;
+    digits = digits > 4 ? digits - 4 : 1;
+  }
+  return formatDecimal16(str, n, digits);
+}
+
+static char *formatNumber(char *str, unsigned long n, uint8_t base)
+{
+  if (base == 10) {
+    return formatDecimal(str, n);
+  }
+  if (base == 16) {
+    do {
+      uint8_t c = n & 0x0F;
+      *--str = c < 10 ? c + '0' : c + 'A' - 10;
+      n >>= 4;
+    } while (n);
+    return str;
+  }
+
+  // prevent crash if called with base == 1
+  if (base < 2) base = 10;
+
+  do {
+    char c = n % base;
+    n /= base;
+
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while(n);
+  return str;
+}
+
+// 'digits' fraction digits of a positive number, rounded half up. The
+// value is scaled to an integer and rounded once, instead of summing
+// digits extracted one at a time from a float remainder. Beyond
+// PRINT_FLOAT_PRECISION digits a float has nothing left, those are zeros.
+static char *formatFloat(char *str, double number, uint8_t digits)
+{
+  uint8_t computed = digits < PRINT_FLOAT_PRECISION ? digits : PRINT_FLOAT_PRECISION;
+  unsigned long scale = 1;
+  unsigned long int_part, fraction;
+  uint8_t zeros = 0;
+
+  for (uint8_t i = computed; i < digits; i++) {
+    *--str = '0';
+  }
+  for (uint8_t i = 0; i < computed; i++) {
+    scale *= 10;
+  }
+
+  // 4294967040 is the largest float below 2^32
+  if (number * scale < 4294967040.0) {
+    unsigned long scaled = (unsigned long)(number * scale + 0.5);
+    int_part = scaled / scale;
+    fraction = scaled - int_part * scale;
+  } else if (number < 4294967040.0) {
+    int_part = (unsigned long)number;
+    fraction = (unsigned long)((number - int_part) * scale + 0.5);
+    if (fraction >= scale) {
+      fraction -= scale;
+      int_part++;
+    }
+  } else {
+    // no fraction left; the leading digits, then zeros
+    while (number >= 4294967040.0) {
+      number /= 10.0;
+      zeros++;
+    }
+    int_part = (unsigned long)(number + 0.5);
+    fraction = 0;
+  }
+
+  if (computed) {
+    str = formatDecimal(str, fraction, computed);
+  }
+  if (digits) {
+    *--str = '.';
+  }
+  while (zeros--) {
+    *--str = '0';
+  }
+  return formatDecimal(str, int_part);
+}
+
 // Public Methods //////////////////////////////////////////////////////////////
 
 /* default implementation: may be overridden */
@@ -41,15 +152,24 @@ size_t Print::write(const uint8_t *buffer, size_t size)
   return n;
 }
 
+// copied to RAM in chunks, each one goes out in a single write()
 size_t Print::print(const __FlashStringHelper *ifsh)
 {
   PGM_P p = reinterpret_cast<PGM_P>(ifsh);
+  char buf[PRINT_FLASH_CHUNK];
   size_t n = 0;
   while (1) {
-    unsigned char c = pgm_read_byte(p++);
+    uint8_t len = 0;
+    char c = 0;
+    while (len < sizeof(buf) && (c = pgm_read_byte(p++)) != 0) {
+      buf[len++] = c;
+    }
+    if (len) {
+      size_t written = write(buf, len);
+      n += written;
+      if (written < len) break;
+    }
     if (c == 0) break;
-    if (write(c)) n++;
-    else break;
   }
   return n;
 }
@@ -90,9 +210,7 @@ size_t Print::print(long n, int base)
     return write(n);
   } else if (base == 10) {
     if (n < 0) {
-      int t = print('-');
-      n = -n;
-      return printNumber(n, 10) + t;
+      return printNumber(-(unsigned long)n, 10, true);
     }
     return printNumber(n, 10);
   } else {
@@ -111,6 +229,11 @@ size_t Print::print(double n, int digits)
   return printFloat(n, digits);
 }
 
+size_t Print::print(double n, int digits, int width, char pad)
+{
+  return printFloat(n, digits, width, pad);
+}
+
 size_t Print::println(const __FlashStringHelper *ifsh)
 {
   size_t n = print(ifsh);
@@ -118,6 +241,31 @@ size_t Print::println(const __FlashStringHelper *ifsh)
   return n;
 }
 
+size_t Print::printFixed(int32_t value, uint8_t fracDigits, uint8_t width, char pad)
+{
+  char buf[PRINT_FIXED_BUFFER];
+  char *end = &buf[sizeof(buf)];
+  unsigned long n = value < 0 ? -(unsigned long)value : value;
+
+  if (fracDigits > PRINT_FIXED_DIGITS) {
+    fracDigits = PRINT_FIXED_DIGITS;
+  }
+
+  // all digits with a zero before the point if needed, then the integer
+  // part moves one to the left to make room for the point; no division
+  char *str = formatDecimal(end, n, fracDigits + 1);
+  if (fracDigits) {
+    memmove(str - 1, str, (end - str) - fracDigits);
+    str--;
+    end[-1 - fracDigits] = '.';
+  }
+
+  if (value < 0) {
+    *--str = '-';
+  }
+  return writePadded(buf, str, end, width, pad);
+}
+
 size_t Print::print(const Printable& x)
 {
   return x.printTo(*this);
@@ -191,6 +339,20 @@ size_t Print::println(double num, int digits)
   return n;
 }
 
+size_t Print::println(double num, int digits, int width, char pad)
+{
+  size_t n = print(num, digits, width, pad);
+  n += println();
+  return n;
+}
+
+size_t Print::printlnFixed(int32_t value, uint8_t fracDigits, uint8_t width, char pad)
+{
+  size_t n = printFixed(value, fracDigits, width, pad);
+  n += println();
+  return n;
+}
+
 size_t Print::println(const Printable& x)
 {
   size_t n = print(x);
@@ -198,69 +360,318 @@ size_t Print::println(const Printable& x)
   return n;
 }
 
-// Private Methods /////////////////////////////////////////////////////////////
+// Formatted output ////////////////////////////////////////////////////////////
 
-size_t Print::printNumber(unsigned long n, uint8_t base)
+// Output of one format() call, collected so it leaves in as few writes
+// as possible
+class PrintFormat
 {
-  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus zero byte.
-  char *str = &buf[sizeof(buf) - 1];
+  public:
+    PrintFormat(Print &out) : _out(out), _length(0), _written(0) {}
 
-  *str = '\0';
+    void put(char c) {
+      if (_length == sizeof(_buffer)) flush();
+      _buffer[_length++] = c;
+    }
+    void put(const char *str, size_t size) {
+      while (size--) put(*str++);
+    }
+    void pad(char c, uint8_t count) {
+      while (count--) put(c);
+    }
+    size_t flush() {
+      if (_length) {
+        _written += _out.write(_buffer, _length);
+        _length = 0;
+      }
+      return _written;
+    }
 
-  // prevent crash if called with base == 1
-  if (base < 2) base = 10;
+  private:
+    Print &_out;
+    char _buffer[PRINT_FORMAT_BUFFER];
+    uint8_t _length;
+    size_t _written;
+};
 
-  do {
-    char c = n % base;
-    n /= base;
+// str padded to the field width, zeros go between the sign and the digits
+static void putField(PrintFormat &out, const PrintSpec &spec, const char *str, size_t size)
+{
+  uint8_t fill = spec.width > size ? spec.width - size : 0;
 
-    *--str = c < 10 ? c + '0' : c + 'A' - 10;
-  } while(n);
+  if (spec.left) {
+    out.put(str, size);
+    out.pad(' ', fill);
+    return;
+  }
+  if (spec.pad == '0' && size && *str == '-') {
+    out.put(*str++);
+    size--;
+  }
+  out.pad(spec.pad, fill);
+  out.put(str, size);
+}
 
-  return write(str);
+static void putNumber(PrintFormat &out, const PrintSpec &spec, unsigned long n, bool negative)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *end = &buf[sizeof(buf)];
+  char *str;
+
+  if (spec.conversion == 'x' || spec.conversion == 'X') {
+    str = formatNumber(end, n, 16);
+    if (spec.conversion == 'x') {
+      for (char *c = str; c < end; c++) {
+        if (*c >= 'A') *c += 'a' - 'A';
+      }
+    }
+  } else {
+    str = formatDecimal(end, n);
+    if (negative) {
+      *--str = '-';
+    }
+  }
+  putField(out, spec, str, end - str);
 }
 
-size_t Print::printFloat(double number, uint8_t digits) 
-{ 
-  size_t n = 0;
-  
-  if (isnan(number)) return print("nan");
-  if (isinf(number)) return print("inf");
-  if (number > 4294967040.0) return print ("ovf");  // constant determined empirically
-  if (number <-4294967040.0) return print ("ovf");  // constant determined empirically
-  
-  // Handle negative numbers
-  if (number < 0.0)
-  {
-     n += print('-');
-     number = -number;
-  }
-
-  // Round correctly so that print(1.999, 2) prints as "2.00"
-  double rounding = 0.5;
-  for (uint8_t i=0; i<digits; ++i)
-    rounding /= 10.0;
-  
-  number += rounding;
-
-  // Extract the integer part of the number and print it
-  unsigned long int_part = (unsigned long)number;
-  double remainder = number - (double)int_part;
-  n += print(int_part);
-
-  // Print the decimal point, but only if there are digits beyond
-  if (digits > 0) {
-    n += print('.'); 
-  }
-
-  // Extract digits from the remainder one at a time
-  while (digits-- > 0)
-  {
-    remainder *= 10.0;
-    unsigned int toPrint = (unsigned int)(remainder);
-    n += print(toPrint);
-    remainder -= toPrint; 
-  } 
-  
-  return n;
+void PrintArg::emitChar(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  char c = arg.value.l;
+  putField(out, spec, &c, 1);
+}
+
+// int is widened to long in the PrintArg, hex has to narrow it again
+void PrintArg::emitInt(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  if (spec.conversion == 'x' || spec.conversion == 'X') {
+    putNumber(out, spec, (unsigned int)arg.value.l, false);
+  } else {
+    emitSigned(out, arg, spec);
+  }
+}
+
+void PrintArg::emitSigned(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  long n = arg.value.l;
+
+  // hex shows the two's complement of the long, like printf's %lx
+  if (n < 0 && spec.conversion != 'x' && spec.conversion != 'X') {
+    putNumber(out, spec, -(unsigned long)n, true);
+  } else {
+    putNumber(out, spec, n, false);
+  }
+}
+
+void PrintArg::emitUnsigned(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  putNumber(out, spec, arg.value.ul, false);
+}
+
+void PrintArg::emitFloat(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  char buf[PRINT_FLOAT_BUFFER];
+  char *end = &buf[sizeof(buf)];
+  char *str;
+  double number = arg.value.d;
+  uint8_t digits = spec.precision < 0 ? 2 : spec.precision;
+
+  if (isnan(number)) {
+    str = end - 3;
+    memcpy(str, "nan", 3);
+  } else if (isinf(number)) {
+    str = end - 3;
+    memcpy(str, "inf", 3);
+  } else {
+    bool negative = number < 0.0;
+    if (negative) {
+      number = -number;
+    }
+    if (digits > PRINT_FLOAT_DIGITS) {
+      digits = PRINT_FLOAT_DIGITS;
+    }
+    str = formatFloat(end, number, digits);
+    if (negative) {
+      *--str = '-';
+    }
+  }
+  putField(out, spec, str, end - str);
+}
+
+// the precision, if given, is the most characters printed
+void PrintArg::emitString(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  const char *str = arg.value.s ? arg.value.s : "";
+  size_t size = strlen(str);
+
+  if (spec.precision >= 0 && size > (size_t)spec.precision) {
+    size = spec.precision;
+  }
+  putField(out, spec, str, size);
+}
+
+void PrintArg::emitFlashString(PrintFormat &out, const PrintArg &arg, const PrintSpec &spec)
+{
+  PGM_P str = arg.value.s;
+  size_t size = strlen_P(str);
+
+  if (spec.precision >= 0 && size > (size_t)spec.precision) {
+    size = spec.precision;
+  }
+  uint8_t fill = spec.width > size ? spec.width - size : 0;
+  if (!spec.left) {
+    out.pad(' ', fill);
+  }
+  while (size--) {
+    out.put(pgm_read_byte(str++));
+  }
+  if (spec.left) {
+    out.pad(' ', fill);
+  }
+}
+
+// A width or precision in the format string, clamped to max rather than
+// wrapping around in its field of PrintSpec
+static uint8_t readCount(PGM_P &p, char &c, uint8_t max)
+{
+  uint16_t n = 0;
+
+  while (c >= '0' && c <= '9') {
+    if (n < max) {
+      n = n * 10 + (c - '0');
+    }
+    c = pgm_read_byte(p++);
+  }
+  return n < max ? n : max;
+}
+
+// The format string is read from flash once, each conversion takes the
+// next argument. Length modifiers (l, h) are accepted and ignored, the
+// arguments carry their types; a conversion without an argument prints
+// nothing.
+size_t Print::vformat(const __FlashStringHelper *fmt, const PrintArg *args, uint8_t count)
+{
+  PGM_P p = reinterpret_cast<PGM_P>(fmt);
+  PrintFormat out(*this);
+  uint8_t next = 0;
+  char c;
+
+  while ((c = pgm_read_byte(p++)) != 0) {
+    if (c != '%') {
+      out.put(c);
+      continue;
+    }
+
+    c = pgm_read_byte(p++);
+    if (c == '%') {
+      out.put(c);
+      continue;
+    }
+
+    PrintSpec spec = { 0, ' ', false, 0, -1 };
+    for (;; c = pgm_read_byte(p++)) {
+      if (c == '-') spec.left = true;
+      else if (c == '0') spec.pad = '0';
+      else break;
+    }
+    if (spec.left) spec.pad = ' ';
+    spec.width = readCount(p, c, 255);
+    if (c == '.') {
+      c = pgm_read_byte(p++);
+      spec.precision = readCount(p, c, 127);
+    }
+    while (c == 'l' || c == 'h') {
+      c = pgm_read_byte(p++);
+    }
+    if (c == 0) {
+      break;
+    }
+
+    spec.conversion = c;
+    if (next < count) {
+      args[next].emit(out, args[next], spec);
+      next++;
+    }
+  }
+
+  return out.flush();
+}
+
+// Private Methods /////////////////////////////////////////////////////////////
+
+size_t Print::printNumber(unsigned long n, uint8_t base, bool negative)
+{
+  char buf[8 * sizeof(long) + 1]; // Assumes 8-bit chars plus the sign.
+  char *end = &buf[sizeof(buf)];
+  char *str = formatNumber(end, n, base);
+
+  if (negative) {
+    *--str = '-';
+  }
+  return write(str, end - str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits, int width, char pad)
+{
+  char buf[PRINT_FLOAT_BUFFER];
+  char *end = &buf[sizeof(buf)];
+  char *str;
+
+  if (isnan(number)) {
+    str = end - 3;
+    memcpy(str, "nan", 3);
+  } else if (isinf(number)) {
+    str = end - 3;
+    memcpy(str, "inf", 3);
+  } else {
+    bool negative = number < 0.0;
+    if (negative) {
+      number = -number;
+    }
+    if (digits > PRINT_FLOAT_DIGITS) {
+      digits = PRINT_FLOAT_DIGITS;
+    }
+    str = formatFloat(end, number, digits);
+    if (negative) {
+      *--str = '-';
+    }
+  }
+
+  return writePadded(buf, str, end, width, pad);
+}
+
+// Write str up to end in one piece, padded to |width| characters: on the
+// left for a positive width, on the right for a negative one. A '0' pad
+// goes between the sign and the digits. buf is the start of the buffer
+// holding str, the padding is built in there.
+size_t Print::writePadded(char *buf, char *str, char *end, int width, char pad)
+{
+  size_t size = end - buf;
+  size_t target = width < 0 ? -width : width;
+  size_t len = end - str;
+
+  if (target > size) {
+    target = size;
+  }
+  if (len < target) {
+    if (width < 0) {
+      memmove(buf, str, len);
+      str = buf;
+      end = buf + len;
+      while (len++ < target) {
+        *end++ = pad;
+      }
+    } else {
+      char sign = 0;
+      if (pad == '0' && *str == '-') {
+        sign = *str++;
+      }
+      while (len++ < target) {
+        *--str = pad;
+      }
+      if (sign) {
+        *--str = sign;
+      }
+    }
+  }
+  return write(str, end - str);
 }
@@ -22,6 +22,8 @@
 
 #include "wiring_private.h"
 
+#include <avr/power.h>
+
 // the prescaler is set so that timer0 ticks every 64 clock cycles, and the
 // the overflow handler is called every 256 ticks.
 #define MICROSECONDS_PER_TIMER0_OVERFLOW (clockCyclesToMicroseconds(64 * 256))
@@ -35,23 +37,34 @@
 #define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
 #define FRACT_MAX (1000 >> 3)
 
+// the number of clock prescale handlers which can be attached
+#define CLOCK_PRESCALE_HANDLERS 4
+
 volatile unsigned long timer0_overflow_count = 0;
 volatile unsigned long timer0_millis = 0;
 static unsigned char timer0_fract = 0;
 
-#if defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
-ISR(TIM0_OVF_vect)
-#else
-ISR(TIMER0_OVF_vect)
-#endif
+// timer0 ticks counted as if the CPU always ran at F_CPU, so micros()
+// stays continuous when the system clock prescaler changes
+static volatile unsigned long timer0_ticks = 0;
+
+// system clock division (clock_div_t from avr/power.h, log2 of the divider)
+// and the per overflow increments derived from it
+static volatile unsigned char timer0_clock_shift = 0;
+static volatile unsigned int timer0_millis_inc = MILLIS_INC;
+static volatile unsigned char timer0_fract_inc = FRACT_INC;
+
+static void (*clock_prescale_handlers[CLOCK_PRESCALE_HANDLERS])(uint8_t);
+
+static inline void timer0_overflow(void)
 {
 	// copy these to local variables so they can be stored in registers
 	// (volatile variables must be read from memory on every access)
 	unsigned long m = timer0_millis;
 	unsigned char f = timer0_fract;
 
-	m += MILLIS_INC;
-	f += FRACT_INC;
+	m += timer0_millis_inc;
+	f += timer0_fract_inc;
 	if (f >= FRACT_MAX) {
 		f -= FRACT_MAX;
 		m += 1;
@@ -60,6 +73,16 @@ ISR(TIMER0_OVF_vect)
 	timer0_fract = f;
 	timer0_millis = m;
 	timer0_overflow_count++;
+	timer0_ticks += 256UL << timer0_clock_shift;
+}
+
+#if defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) || defined(__AVR_ATtiny84__)
+ISR(TIM0_OVF_vect)
+#else
+ISR(TIMER0_OVF_vect)
+#endif
+{
+	timer0_overflow();
 }
 
 unsigned long millis()
@@ -81,7 +104,7 @@ unsigned long micros() {
 	uint8_t oldSREG = SREG, t;
 	
 	cli();
-	m = timer0_overflow_count;
+	m = timer0_ticks;
 #if defined(TCNT0)
 	t = TCNT0;
 #elif defined(TCNT0L)
@@ -92,15 +115,17 @@ unsigned long micros() {
 
 #ifdef TIFR0
 	if ((TIFR0 & _BV(TOV0)) && (t < 255))
-		m++;
+		m += 256UL << timer0_clock_shift;
 #else
 	if ((TIFR & _BV(TOV0)) && (t < 255))
-		m++;
+		m += 256UL << timer0_clock_shift;
 #endif
 
+	m += (unsigned long)t << timer0_clock_shift;
+
 	SREG = oldSREG;
 	
-	return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
+	return m * (64 / clockCyclesPerMicrosecond());
 }
 
 void delay(unsigned long ms)
@@ -124,6 +149,11 @@ void delayMicroseconds(unsigned int us)
 	// calling avrlib's delay_us() function with low values (e.g. 1 or
 	// 2 microseconds) gives delays longer than desired.
 	//delay_us(us);
+
+	// the loops below are calibrated for F_CPU, when the system clock is
+	// divided at runtime every iteration takes proportionally longer
+	us >>= timer0_clock_shift;
+
 #if F_CPU >= 24000000L
 	// for the 24 MHz clock for the aventurous ones, trying to overclock
 
@@ -238,6 +268,179 @@ void delayMicroseconds(unsigned int us)
 	// return = 4 cycles
 }
 
+// Set the a2d prescaler so the ADC clock stays inside the desired
+// 50-200 KHz range for the given system clock frequency.
+static void adc_prescaler_update(unsigned long frequency)
+{
+#if defined(ADCSRA)
+	uint8_t adps;
+
+	if (frequency >= 16000000) { // 16 MHz / 128 = 125 KHz
+		adps = _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+	} else if (frequency >= 8000000) { // 8 MHz / 64 = 125 KHz
+		adps = _BV(ADPS2) | _BV(ADPS1);
+	} else if (frequency >= 4000000) { // 4 MHz / 32 = 125 KHz
+		adps = _BV(ADPS2) | _BV(ADPS0);
+	} else if (frequency >= 2000000) { // 2 MHz / 16 = 125 KHz
+		adps = _BV(ADPS2);
+	} else if (frequency >= 1000000) { // 1 MHz / 8 = 125 KHz
+		adps = _BV(ADPS1) | _BV(ADPS0);
+	} else { // 128 kHz / 2 = 64 KHz -> This is the closest you can get, the prescaler is 2
+		adps = _BV(ADPS0);
+	}
+
+	ADCSRA = (ADCSRA & ~(_BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0))) | adps;
+#endif
+}
+
+static void clock_prescale_notify(uint8_t phase)
+{
+	uint8_t i;
+
+	for (i = 0; i < CLOCK_PRESCALE_HANDLERS; i++) {
+		if (clock_prescale_handlers[i]) {
+			clock_prescale_handlers[i](phase);
+		}
+	}
+}
+
+void attachClockPrescaleHandler(void (*handler)(uint8_t))
+{
+	uint8_t i;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	for (i = 0; i < CLOCK_PRESCALE_HANDLERS; i++) {
+		if (clock_prescale_handlers[i] == handler) {
+			break;
+		}
+		if (clock_prescale_handlers[i] == 0) {
+			clock_prescale_handlers[i] = handler;
+			break;
+		}
+	}
+	SREG = oldSREG;
+}
+
+void detachClockPrescaleHandler(void (*handler)(uint8_t))
+{
+	uint8_t i;
+	uint8_t oldSREG = SREG;
+
+	cli();
+	for (i = 0; i < CLOCK_PRESCALE_HANDLERS; i++) {
+		if (clock_prescale_handlers[i] == handler) {
+			clock_prescale_handlers[i] = 0;
+		}
+	}
+	SREG = oldSREG;
+}
+
+uint8_t getClockPrescale(void)
+{
+	return timer0_clock_shift;
+}
+
+unsigned long getClockFrequency(void)
+{
+	return F_CPU >> timer0_clock_shift;
+}
+
+void setClockPrescale(uint8_t div)
+{
+	unsigned long us;
+	unsigned long m;
+	unsigned char f;
+	uint8_t oldSREG;
+	uint8_t t;
+
+	if (div > clock_div_256) {
+		div = clock_div_256;
+	}
+	if (div == timer0_clock_shift) {
+		return;
+	}
+
+	// let the peripherals finish what they are doing at the old clock
+	clock_prescale_notify(CLOCK_PRESCALE_BEFORE);
+
+	oldSREG = SREG;
+	cli();
+
+	// fold the part of the current timer0 period which already passed
+	// into the counters, it was measured with the old clock
+#if defined(TCNT0)
+	t = TCNT0;
+#elif defined(TCNT0L)
+	t = TCNT0L;
+#endif
+
+	// a pending overflow also belongs to the old clock, account for it
+	// here instead of letting the interrupt scale it with the new one
+#ifdef TIFR0
+	if (TIFR0 & _BV(TOV0)) {
+		TIFR0 = _BV(TOV0);
+#else
+	if (TIFR & _BV(TOV0)) {
+		TIFR = _BV(TOV0);
+#endif
+		timer0_overflow();
+#if defined(TCNT0)
+		t = TCNT0;
+#elif defined(TCNT0L)
+		t = TCNT0L;
+#endif
+	}
+	timer0_ticks += (unsigned long)t << timer0_clock_shift;
+
+	us = ((unsigned long)t << timer0_clock_shift) * (64 / clockCyclesPerMicrosecond());
+	m = timer0_millis + us / 1000;
+	f = timer0_fract + ((us % 1000) >> 3);
+	if (f >= FRACT_MAX) {
+		f -= FRACT_MAX;
+		m += 1;
+	}
+	timer0_millis = m;
+	timer0_fract = f;
+
+#if defined(TCNT0)
+	TCNT0 = 0;
+#elif defined(TCNT0L)
+	TCNT0L = 0;
+#endif
+
+	clock_prescale_set((clock_div_t)div);
+
+	// every timer0 overflow takes 2^div times longer now
+	us = (unsigned long)MICROSECONDS_PER_TIMER0_OVERFLOW << div;
+	timer0_clock_shift = div;
+	timer0_millis_inc = us / 1000;
+	timer0_fract_inc = (us % 1000) >> 3;
+
+	SREG = oldSREG;
+
+	adc_prescaler_update(getClockFrequency());
+
+	clock_prescale_notify(CLOCK_PRESCALE_AFTER);
+}
+
+// MCUSR as found after reset, saved before the C runtime clears .bss.
+// The flags only go away when written, so it is cleared here: otherwise
+// the power-on flag would stay set through every later reset.
+static uint8_t reset_cause __attribute__((section(".noinit")));
+
+void saveResetCause(void) __attribute__((naked, used, section(".init3")));
+void saveResetCause(void)
+{
+	reset_cause = MCUSR;
+	MCUSR = 0;
+}
+
+uint8_t resetCause(void)
+{
+	return reset_cause;
+}
+
 void init()
 {
 	// this needs to be called before setup() or some functions won't
@@ -352,31 +555,7 @@ void init()
 
 #if defined(ADCSRA)
 	// set a2d prescaler so we are inside the desired 50-200 KHz range.
-	#if F_CPU >= 16000000 // 16 MHz / 128 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 8000000 // 8 MHz / 64 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		cbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 4000000 // 4 MHz / 32 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 2000000 // 2 MHz / 16 = 125 KHz
-		sbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		cbi(ADCSRA, ADPS0);
-	#elif F_CPU >= 1000000 // 1 MHz / 8 = 125 KHz
-		cbi(ADCSRA, ADPS2);
-		sbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#else // 128 kHz / 2 = 64 KHz -> This is the closest you can get, the prescaler is 2
-		cbi(ADCSRA, ADPS2);
-		cbi(ADCSRA, ADPS1);
-		sbi(ADCSRA, ADPS0);
-	#endif
+	adc_prescaler_update(F_CPU);
 	// enable a2d conversions
 	sbi(ADCSRA, ADEN);
 #endif
@@ -41,13 +41,14 @@ unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout)
 
 	// convert the timeout from microseconds to a number of times through
 	// the initial loop; it takes approximately 16 clock cycles per iteration
-	unsigned long maxloops = microsecondsToClockCycles(timeout)/16;
+	// (the loop runs slower when the system clock is divided at runtime)
+	unsigned long maxloops = (microsecondsToClockCycles(timeout)/16) >> getClockPrescale();
 
 	unsigned long width = countPulseASM(portInputRegister(port), bit, stateMask, maxloops);
 
 	// prevent clockCyclesToMicroseconds to return bogus values if countPulseASM timed out
 	if (width)
-		return clockCyclesToMicroseconds(width * 16 + 16);
+		return clockCyclesToMicroseconds(width * 16 + 16) << getClockPrescale();
 	else
 		return 0;
 }
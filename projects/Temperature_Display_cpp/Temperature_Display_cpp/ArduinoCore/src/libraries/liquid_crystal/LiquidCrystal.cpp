@@ -10,6 +10,21 @@
   #include "WProgram.h"
   #endif
 
+// Set or clear a pin through its precomputed port register. The
+// read-modify-write must not race with interrupt handlers touching
+// the same port.
+static inline void lcdPinWrite(volatile uint8_t *out, uint8_t mask, uint8_t value)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  if (value) {
+    *out |= mask;
+  } else {
+    *out &= ~mask;
+  }
+  SREG = oldSREG;
+}
+
 // When the display powers up, it is configured as follows:
 //
 // 1. Display clear
@@ -32,7 +47,8 @@
 // 11
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
-			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) :
+  _usingSpi(false), _usingI2c(false), _i2c(0)
 {
   init(0, rs, rw, enable, d0, d1, d2, d3, d4, d5, d6, d7, 255);
 }
@@ -40,34 +56,39 @@ LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
 // 10
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
-			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
+			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) :
+  _usingSpi(false), _usingI2c(false), _i2c(0)
 {
   init(0, rs, 255, enable, d0, d1, d2, d3, d4, d5, d6, d7, 255);
 }
 
 // 8
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
-			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t bl)
+			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t bl) :
+  _usingSpi(false), _usingI2c(false), _i2c(0)
 {
   init(1, rs, rw, enable, d0, d1, d2, d3, 0, 0, 0, 0, bl);
 }
 
 // 7
 LiquidCrystal::LiquidCrystal(uint8_t rs,  uint8_t enable,
-				uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t bl)
+				uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3, uint8_t bl) :
+  _usingSpi(false), _usingI2c(false), _i2c(0)
 {
 	init(1, rs, 255, enable, d0, d1, d2, d3, 0, 0, 0, 0, bl);
 }
 
 // 6
 LiquidCrystal::LiquidCrystal(uint8_t rs,  uint8_t enable,
-			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
+			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3) :
+  _usingSpi(false), _usingI2c(false), _i2c(0)
 {
   init(1, rs, 255, enable, d0, d1, d2, d3, 0, 0, 0, 0, 255);
 }
 
 // 1
-LiquidCrystal::LiquidCrystal(uint8_t ssPin) //SPI  ##############################
+LiquidCrystal::LiquidCrystal(uint8_t ssPin) : //SPI  ############################
+  _usingSpi(true), _usingI2c(false), _i2c(0)
 {
   initSPI(ssPin);
   //shiftRegister pins 1,2,3,4,5,6,7 represent rs, rw, enable, d4-7 in that order
@@ -94,30 +115,84 @@ void LiquidCrystal::init(uint8_t fourbitmode, uint8_t rs, uint8_t rw, uint8_t en
   
   _backlight_pin = bl;
 
-  pinMode(_rs_pin, OUTPUT);
-  // we can save 1 pin by not using RW. Indicate by passing 255 instead of pin#
-  if (_rw_pin != 255) { 
-    pinMode(_rw_pin, OUTPUT);
+  // with SPI and I2C the pin numbers are shift register/expander bits
+  if (!_usingSpi && !_usingI2c) {
+    pinMode(_rs_pin, OUTPUT);
+    // we can save 1 pin by not using RW. Indicate by passing 255 instead of pin#
+    if (_rw_pin != 255) { 
+      pinMode(_rw_pin, OUTPUT);
+    }
+    pinMode(_enable_pin, OUTPUT);
   }
-  pinMode(_enable_pin, OUTPUT);
   
   if (fourbitmode)
     _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
   else 
     _displayfunction = LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
-  
-  begin(16, 1);
-  
-  //since in initSPI constructor we set _usingSPI to true and we run it first
-  //from SPI constructor, we do nothing here otherwise we set it to false
-  if (_usingSpi) //SPI ######################################################
-  {
-    ;
+
+  _queued = false;
+  _queue_running = false;
+
+  _bus_out = 0;
+  if (!_usingSpi && !_usingI2c) {
+    initPorts(fourbitmode ? 4 : 8);
+  }
+
+  // the display is set up by begin() from the sketch, once the clock and
+  // the timers run; until then the defaults of begin(16, 1) apply
+  _numlines = 1;
+  _numcols = 16;
+  _currline = 0;
+  _ac = 0xFF;
+  _shift = 0;
+  _busyPolling = false;
+  _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
+  _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+}
+
+// Look up the port registers and bit masks of the parallel bus once.
+// digitalWrite does this from PROGMEM on every call, together with the
+// PWM check, which made a single character cost tens of microseconds.
+void LiquidCrystal::initPorts(uint8_t width)
+{
+  _rs_out = portOutputRegister(digitalPinToPort(_rs_pin));
+  _rs_mask = digitalPinToBitMask(_rs_pin);
+  _enable_out = portOutputRegister(digitalPinToPort(_enable_pin));
+  _enable_mask = digitalPinToBitMask(_enable_pin);
+  if (_rw_pin != 255) {
+    _rw_out = portOutputRegister(digitalPinToPort(_rw_pin));
+    _rw_mask = digitalPinToBitMask(_rw_pin);
+  }
+
+  uint8_t port = digitalPinToPort(_data_pins[0]);
+  _bus_mask = 0;
+  _bus_shift = 0;
+  while (_bus_shift < 7 && !(digitalPinToBitMask(_data_pins[0]) & (1 << _bus_shift))) {
+    _bus_shift++;
+  }
+
+  for (uint8_t i = 0; i < width; i++) {
+    // digitalWrite also turns off PWM on the pin, the fast path never does
+    pinMode(_data_pins[i], OUTPUT);
+    digitalWrite(_data_pins[i], LOW);
+
+    _data_out[i] = portOutputRegister(digitalPinToPort(_data_pins[i]));
+    _data_mask[i] = digitalPinToBitMask(_data_pins[i]);
+    if (digitalPinToPort(_data_pins[i]) != port) {
+      port = NOT_A_PORT;
+    }
+    if (_data_mask[i] != (uint8_t)(_data_mask[0] << i)) {
+      _bus_shift = 0xFF;
+    }
+    _bus_mask |= _data_mask[i];
+  }
+
+  // the whole nibble (or byte) goes out in one read-modify-write
+  if (port != NOT_A_PORT) {
+    _bus_out = portOutputRegister(port);
+    _bus_ddr = portModeRegister(port);
+    _bus_in = portInputRegister(port);
   }
-  else
-  {
-    _usingSpi = false;
-  }	
 }
 
 void LiquidCrystal::initSPI(uint8_t ssPin) //SPI ##########################################
@@ -128,27 +203,34 @@ void LiquidCrystal::initSPI(uint8_t ssPin) //SPI ###############################
 	pinMode (_latchPin, OUTPUT); //just in case _latchPin is not 10 or 53 set it to output 
 								 //otherwise SPI.begin() will set it to output but just in case
 		
+	digitalWrite(_latchPin, HIGH);
+	_latch_out = portOutputRegister(digitalPinToPort(_latchPin));
+	_latch_mask = digitalPinToBitMask(_latchPin);
+		
 	SPI.begin(); 
 	
-	//set clockDivider to SPI_CLOCK_DIV2 by default which is 8MHz
-	_clockDivider = SPI_CLOCK_DIV2;
-	SPI.setClockDivider(_clockDivider);
-	
-	//set data mode to SPI_MODE0 by default
-	_dataMode = SPI_MODE0;
-	SPI.setDataMode(_dataMode);
-	
-	//set bitOrder to MSBFIRST by default
-	_bitOrder = MSBFIRST; 
-	SPI.setBitOrder(_bitOrder);
+	//half the CPU clock (8MHz), MSB first, SPI_MODE0; one byte takes longer
+	//than the 450ns enable pulse, so no delays are needed between states
+	_spiSettings = SPISettings(F_CPU / 2, MSBFIRST, SPI_MODE0);
+	_spi_sent = 0;
+	_spi_settle = 0;
 }
 
 void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
+  // the initialisation sequence has its own timing
+  endQueue();
+
   if (lines > 1) {
     _displayfunction |= LCD_2LINE;
   }
   _numlines = lines;
+  _numcols = cols;
   _currline = 0;
+  _ac = 0xFF;
+  _shift = 0;
+
+  // the busy flag can not be read until the interface width is set
+  _busyPolling = false;
 
   // for some 1 line displays you can select a 10 pixel high font
   if ((dotsize != 0) && (lines == 1)) {
@@ -157,13 +239,23 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 
   // SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
   // according to datasheet, we need at least 40ms after power rises above 2.7V
-  // before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
-  delayMicroseconds(50000); 
+  // before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50,
+  // counted from reset: the time the sketch spent before begin() counts too.
+  // After an external or watchdog reset the display kept its supply and is
+  // long past its power-on reset, the waits only cover instructions which
+  // may still execute from before the reset.
+  bool warm = warmStart();
+  unsigned long now = millis();
+  if (!warm && now < LCD_POWER_UP_TIME) {
+    delayMicroseconds((LCD_POWER_UP_TIME - now) * 1000);
+  }
   // Now we pull both RS and R/W low to begin commands
-  digitalWrite(_rs_pin, LOW);
-  digitalWrite(_enable_pin, LOW);
-  if (_rw_pin != 255) { 
-    digitalWrite(_rw_pin, LOW);
+  if (!_usingSpi && !_usingI2c) {
+    digitalWrite(_rs_pin, LOW);
+    digitalWrite(_enable_pin, LOW);
+    if (_rw_pin != 255) { 
+      digitalWrite(_rw_pin, LOW);
+    }
   }
   
   //put the LCD into 4 bit or 8 bit mode
@@ -171,17 +263,19 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
     // this is according to the hitachi HD44780 datasheet
     // figure 24, pg 46
 
-    // we start in 8bit mode, try to set 4 bit mode
+    // we start in 8bit mode, try to set 4 bit mode. A warm controller
+    // may be waiting for a low nibble, the first one completes it (at
+    // worst into return home), the next two are an 8-bit function set.
     write4bits(0x03);
-    delayMicroseconds(4500); // wait min 4.1ms
+    delayMicroseconds(warm ? LCD_WARM_LONG : 4500); // wait min 4.1ms
 
     // second try
     write4bits(0x03);
-    delayMicroseconds(4500); // wait min 4.1ms
+    delayMicroseconds(warm ? LCD_WARM_SHORT : 4500); // wait min 4.1ms
     
     // third go!
     write4bits(0x03); 
-    delayMicroseconds(150);
+    delayMicroseconds(warm ? LCD_WARM_SHORT : 150);
 
     // finally, set to 4-bit interface
     write4bits(0x02); 
@@ -191,11 +285,11 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 
     // Send function set command sequence
     command(LCD_FUNCTIONSET | _displayfunction);
-    delayMicroseconds(4500);  // wait more than 4.1ms
+    delayMicroseconds(warm ? LCD_WARM_LONG : 4500);  // wait more than 4.1ms
 
     // second try
     command(LCD_FUNCTIONSET | _displayfunction);
-    delayMicroseconds(150);
+    delayMicroseconds(warm ? LCD_WARM_SHORT : 150);
 
     // third go
     command(LCD_FUNCTIONSET | _displayfunction);
@@ -204,6 +298,12 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   // finally, set # lines, font size, etc.
   command(LCD_FUNCTIONSET | _displayfunction);  
 
+  // from now on wait for the busy flag instead of the worst case delays
+  // when it can be read, waitReady() falls back if it never clears
+  if ((_rw_pin != 255) && !_usingSpi) {
+    _busyPolling = true;
+  }
+
   // turn the display on with no cursor or blinking default
   _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;  
   display();
@@ -218,27 +318,41 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 
 }
 
+// Only a reset the display did not see: external or watchdog, with no
+// power-on or brown-out flag. A bootloader which clears MCUSR itself
+// leaves 0, which takes the power-on path.
+bool LiquidCrystal::warmStart()
+{
+  uint8_t cause = resetCause();
+
+  return (cause & (_BV(EXTRF) | _BV(WDRF))) &&
+         !(cause & (_BV(PORF) | _BV(BORF)));
+}
+
 /********** high level commands, for the user! */
 void LiquidCrystal::clear()
 {
   command(LCD_CLEARDISPLAY);  // clear display, set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
+  if (!_busyPolling && !_queued && !_usingSpi && !_usingI2c) {
+    delayMicroseconds(2000);  // this command takes a long time!
+  }
 }
 
 void LiquidCrystal::home()
 {
   command(LCD_RETURNHOME);  // set cursor position to zero
-  delayMicroseconds(2000);  // this command takes a long time!
+  if (!_busyPolling && !_queued && !_usingSpi && !_usingI2c) {
+    delayMicroseconds(2000);  // this command takes a long time!
+  }
 }
 
 void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
 {
-  int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-  if ( row > _numlines ) {
-    row = _numlines-1;    // we count rows starting w/0
+  uint8_t address = lcdAddress(col, row, _numcols, _numlines);
+  if (address == _ac) {
+    return; // the address counter is already there
   }
-  
-  command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+  command(LCD_SETDDRAMADDR | address);
 }
 
 // Turn the display on/off (quickly)
@@ -279,6 +393,55 @@ void LiquidCrystal::scrollDisplayRight(void) {
   command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
+uint8_t LiquidCrystal::pages() {
+  // 1 line mode shifts round 80 columns, rows 2 and 3 of 4 line displays
+  // share the DDRAM lines with rows 0 and 1 and can not scroll on their own
+  if ((_numlines != 2) || (_numcols == 0)) {
+    return 1;
+  }
+  return LCD_LINE_LENGTH / _numcols;
+}
+
+void LiquidCrystal::setPageCursor(uint8_t page, uint8_t col, uint8_t row) {
+  setCursor(page * _numcols + col, row);
+}
+
+// Each shift command moves the window by one column, round the 40 column
+// ring in whichever direction is shorter. Page 0 is also reachable with
+// a single home command.
+void LiquidCrystal::showPage(uint8_t page) {
+  if (page >= pages()) {
+    return;
+  }
+
+  // autoscroll writes to an unknown address may have moved the window
+  if (_shift == 0xFF) {
+    home();
+  }
+
+  uint8_t target = page * _numcols;
+  uint8_t left = (LCD_LINE_LENGTH + target - _shift) % LCD_LINE_LENGTH;
+  uint8_t right = (LCD_LINE_LENGTH - left) % LCD_LINE_LENGTH;
+
+  if (left == 0) {
+    return;
+  }
+  if ((target + 1 < left) && (target + 1 < right)) {
+    home();
+    left = target;
+    right = LCD_LINE_LENGTH;
+  }
+  if (left <= right) {
+    while (left--) {
+      scrollDisplayLeft();
+    }
+  } else {
+    while (right--) {
+      scrollDisplayRight();
+    }
+  }
+}
+
 // This is for text that flows Left to Right
 void LiquidCrystal::leftToRight(void) {
   _displaymode |= LCD_ENTRYLEFT;
@@ -315,32 +478,372 @@ void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
 
 void LiquidCrystal::backlight(uint8_t value)
  {
-	 if (_backlight_pin != 255) {
+	 if (_usingI2c) {
+		 // the backpack switches it on or off only
+		 _i2c->state = value ? (_i2c->state | LCD_I2C_BL) : (_i2c->state & ~LCD_I2C_BL);
+		 i2cWait();
+		 _i2c->buffer[_i2c->length++] = _i2c->state;
+		 i2cSubmit();
+	 } else if (_backlight_pin != 255) {
 		 analogWrite(_backlight_pin, value);
 	 }
  }
 /*********** mid level commands, for sending data/cmds */
 
-inline void LiquidCrystal::command(uint8_t value) {
+void LiquidCrystal::command(uint8_t value) {
   send(value, LOW);
+  trackCommand(value);
 }
 
-inline size_t LiquidCrystal::write(uint8_t value) {
+size_t LiquidCrystal::write(uint8_t value) {
   send(value, HIGH);
+  advanceWrite();
   return 1; // assume sucess
 }
 
+size_t LiquidCrystal::write(const uint8_t *buffer, size_t size) {
+  if (_usingI2c) {
+    // the whole run as one I2C burst, as far as the buffer goes
+    _i2c->batch = true;
+    for (size_t n = 0; n < size; n++) {
+      write(buffer[n]);
+    }
+    _i2c->batch = false;
+    i2cSubmit();
+    return size;
+  }
+  if (!_usingSpi || _queued) {
+    return Print::write(buffer, size);
+  }
+
+  // one transaction for the whole run, the next state sequence is built
+  // while the previous character settles
+  uint8_t seq[LCD_SPI_SEQUENCE];
+  SPI.beginTransaction(_spiSettings);
+  for (size_t n = 0; n < size; n++) {
+    uint8_t count = lcdSpiSequence(seq, buffer[n], HIGH, 2);
+    spiWait();
+    spiBurst(seq, count);
+    _spi_sent = micros();
+    _spi_settle = LCD_SPI_SETTLE;
+    advanceWrite();
+  }
+  SPI.endTransaction();
+  return size;
+}
+
+/************ address counter model */
+
+// follow what an instruction does to the address counter
+void LiquidCrystal::trackCommand(uint8_t value) {
+  if (value & LCD_SETDDRAMADDR) {
+    _ac = value & 0x7F;
+  } else if (value & LCD_SETCGRAMADDR) {
+    _ac = 0xFF;  // writes go to CGRAM now
+  } else if (value & LCD_FUNCTIONSET) {
+    ;
+  } else if (value & LCD_CURSORSHIFT) {
+    if (!(value & LCD_DISPLAYMOVE)) {
+      advanceAddress(value & LCD_MOVERIGHT);
+    } else {
+      shiftWindow(!(value & LCD_MOVERIGHT));
+    }
+  } else if (value & LCD_DISPLAYCONTROL) {
+    ;
+  } else if (value & LCD_ENTRYMODESET) {
+    _displaymode = value & 0x03;
+  } else if (value & LCD_RETURNHOME) {
+    _ac = 0;
+    _shift = 0;
+  } else if (value & LCD_CLEARDISPLAY) {
+    // clear also switches the entry mode back to increment
+    _ac = 0;
+    _shift = 0;
+    _displaymode |= LCD_ENTRYLEFT;
+  }
+}
+
+// A character went to RAM. In entry shift mode (autoscroll) a DDRAM
+// write also moves the window, in the direction the text flows; CGRAM
+// writes don't, and with the counter unknown the window is too.
+void LiquidCrystal::advanceWrite() {
+  bool increment = _displaymode & LCD_ENTRYLEFT;
+
+  if (_displaymode & LCD_ENTRYSHIFTINCREMENT) {
+    if (_ac == 0xFF) {
+      _shift = 0xFF;
+    } else {
+      shiftWindow(increment);
+    }
+  }
+  advanceAddress(increment);
+}
+
+// the window moved by one column, 0xFF stays unknown until home
+void LiquidCrystal::shiftWindow(bool left) {
+  if (_shift == 0xFF) {
+    return;
+  }
+  if (left) {
+    _shift = (_shift == LCD_LINE_LENGTH - 1) ? 0 : _shift + 1;
+  } else {
+    _shift = (_shift == 0) ? LCD_LINE_LENGTH - 1 : _shift - 1;
+  }
+}
+
+// Step the address counter the way the controller does after a write or
+// a cursor move. In 2 line mode each line is 40 cells and the counter
+// wraps from the end of one to the start of the other, in 1 line mode
+// there is a single line of 80.
+void LiquidCrystal::advanceAddress(bool increment) {
+  if (_ac == 0xFF) {
+    return;
+  }
+
+  if (_displayfunction & LCD_2LINE) {
+    if (increment) {
+      _ac = (_ac == 0x27) ? 0x40 : (_ac == 0x67) ? 0x00 : _ac + 1;
+    } else {
+      _ac = (_ac == 0x40) ? 0x27 : (_ac == 0x00) ? 0x67 : _ac - 1;
+    }
+  } else {
+    if (increment) {
+      _ac = (_ac == 0x4F) ? 0x00 : _ac + 1;
+    } else {
+      _ac = (_ac == 0x00) ? 0x4F : _ac - 1;
+    }
+  }
+}
+
+uint8_t LiquidCrystal::readAddressCounter()
+{
+  if (!_busyPolling) {
+    return 0xFF;
+  }
+
+  // the interrupt must not drive the bus while reading it
+  flush();
+
+  waitReady();
+  if (!_busyPolling) {
+    return 0xFF; // the busy flag timed out
+  }
+
+  // the address counter is updated a few us after the busy flag clears
+  delayMicroseconds(4);
+  return readStatus() & LCD_ADDRESSMASK;
+}
+
+/************ queued mode */
+
+// the display served by the Timer2 interrupt
+static LiquidCrystal *queueOwner = 0;
+
+// Timer2 in CTC mode at clk/8, one compare B interrupt per LCD_QUEUE_TICK
+static void queueTimerPeriod(void)
+{
+  unsigned long countsPerTick = (getClockFrequency() / 8 * LCD_QUEUE_TICK + 999999UL) / 1000000UL;
+
+  if (countsPerTick > 256) {
+    countsPerTick = 256;
+  }
+  OCR2A = countsPerTick - 1;
+}
+
+void LiquidCrystal::_clock_prescale_changed(uint8_t phase)
+{
+  // a faster clock must not shorten the tick below the settle time
+  if ((phase == CLOCK_PRESCALE_AFTER) && queueOwner) {
+    queueTimerPeriod();
+  }
+}
+
+bool LiquidCrystal::beginQueue()
+{
+  if (_usingSpi || _usingI2c || (queueOwner && queueOwner != this)) {
+    return false;
+  }
+  if (_queued) {
+    return true;
+  }
+
+  _queue_head = _queue_tail = 0;
+  _queue_hold = 0;
+  _queue_running = false;
+  resetQueueStats();
+
+  uint8_t oldSREG = SREG;
+  cli();
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS21);
+  TCNT2 = 0;
+  OCR2B = 0;
+  queueTimerPeriod();
+  TIFR2 = _BV(OCF2B);
+  queueOwner = this;
+  _queued = true;
+  SREG = oldSREG;
+
+  attachClockPrescaleHandler(_clock_prescale_changed);
+  return true;
+}
+
+void LiquidCrystal::endQueue()
+{
+  if (!_queued) {
+    return;
+  }
+
+  flush();
+  detachClockPrescaleHandler(_clock_prescale_changed);
+
+  uint8_t oldSREG = SREG;
+  cli();
+  TIMSK2 &= ~_BV(OCIE2B);
+  TCCR2B = 0;
+  queueOwner = 0;
+  _queued = false;
+  SREG = oldSREG;
+}
+
+void LiquidCrystal::flush()
+{
+  while (_queue_running) {
+    // the interrupt can not run, do its work here
+    if (bit_is_clear(SREG, SREG_I)) {
+      delayMicroseconds(LCD_QUEUE_TICK);
+      _queue_tick();
+    }
+  }
+}
+
+uint8_t LiquidCrystal::queueDepth()
+{
+  uint8_t head = _queue_head;
+  uint8_t tail = _queue_tail;
+
+  return (uint8_t)(LCD_QUEUE_SIZE + head - tail) % LCD_QUEUE_SIZE;
+}
+
+int LiquidCrystal::availableForWrite()
+{
+  if (!_queued) {
+    return 0;
+  }
+  return LCD_QUEUE_SIZE - 1 - queueDepth();
+}
+
+void LiquidCrystal::resetQueueStats()
+{
+  _queue_peak = 0;
+  _queue_stalls = 0;
+}
+
+void LiquidCrystal::_queue_tick(void)
+{
+  if (_queue_hold) {
+    _queue_hold--;
+    return;
+  }
+
+  // A full tick has passed since the last byte, so it is safe to stop
+  // here: the next write can restart the timer at any point of its period.
+  if (_queue_head == _queue_tail) {
+    TIMSK2 &= ~_BV(OCIE2B);
+    _queue_running = false;
+    return;
+  }
+
+  uint8_t tail = _queue_tail;
+  uint8_t value = _queue[tail];
+  uint8_t mode = (_queue_rs[tail >> 3] >> (tail & 7)) & 0x01;
+  _queue_tail = (tail + 1) % LCD_QUEUE_SIZE;
+
+  transfer(value, mode);
+  if ((mode == LOW) && (value == LCD_CLEARDISPLAY || (value & ~0x01) == LCD_RETURNHOME)) {
+    _queue_hold = LCD_QUEUE_LONG_TICKS;
+  }
+}
+
+ISR(TIMER2_COMPB_vect)
+{
+  if (queueOwner) {
+    queueOwner->_queue_tick();
+  }
+}
+
 /************ low level data pushing commands **********/
 
 // write either command or data, with automatic 4/8-bit selection
 void LiquidCrystal::send(uint8_t value, uint8_t mode) {
-  if (_usingSpi == false)
+  if (_queued) {
+    uint8_t head = _queue_head;
+    uint8_t next = (head + 1) % LCD_QUEUE_SIZE;
+
+    // full, wait for the interrupt to make room
+    if (next == _queue_tail) {
+      _queue_stalls++;
+      while (next == _queue_tail) {
+        if (bit_is_clear(SREG, SREG_I)) {
+          delayMicroseconds(LCD_QUEUE_TICK);
+          _queue_tick();
+        }
+      }
+    }
+
+    _queue[head] = value;
+    if (mode) {
+      _queue_rs[head >> 3] |= 1 << (head & 7);
+    } else {
+      _queue_rs[head >> 3] &= ~(1 << (head & 7));
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+    _queue_head = next;
+    if (!_queue_running) {
+      _queue_running = true;
+      TIFR2 = _BV(OCF2B);
+      TIMSK2 |= _BV(OCIE2B);
+    }
+    SREG = oldSREG;
+
+    uint8_t depth = queueDepth();
+    if (depth > _queue_peak) {
+      _queue_peak = depth;
+    }
+    return;
+  }
+
+  transfer(value, mode);
+}
+
+// put one byte on the bus now, the caller takes care of the timing
+void LiquidCrystal::transfer(uint8_t value, uint8_t mode) {
+  if (_usingI2c) //we use I2C ##########################################
   {
-    digitalWrite(_rs_pin, mode);
+    i2cAppend(value, mode, 2);
+
+    // clear and home need a pause the bus timing does not give them
+    if ((mode == LOW) && (value == LCD_CLEARDISPLAY || (value & ~0x01) == LCD_RETURNHOME)) {
+      i2cSubmit();
+      _i2c->settle = LCD_SPI_SETTLE_LONG;
+    } else if (!_i2c->batch) {
+      i2cSubmit();
+    }
+  }
+  else if (_usingSpi == false)
+  {
+    // the previous instruction has to be finished
+    if (_busyPolling && !_queued) {
+      waitReady();
+    }
+
+    lcdPinWrite(_rs_out, _rs_mask, mode);
 
     // if there is a RW pin indicated, set it low to Write
     if (_rw_pin != 255) { 
-      digitalWrite(_rw_pin, LOW);
+      lcdPinWrite(_rw_out, _rw_mask, LOW);
     }
     
     if (_displayfunction & LCD_8BITMODE) {
@@ -352,79 +855,195 @@ void LiquidCrystal::send(uint8_t value, uint8_t mode) {
   }
   else //we use SPI  ##########################################
   {
-    bitWrite(_bitString, _rs_pin, mode); //set RS to mode
-    spiSendOut();
-    
 	//we are not using RW with SPI so we are not even bothering
-	//or 8BITMODE so we go straight to write4bits
-    write4bits(value>>4);
-    write4bits(value);    
+	//or 8BITMODE, both nibbles go out in one burst
+    uint8_t seq[LCD_SPI_SEQUENCE];
+    uint8_t count = lcdSpiSequence(seq, value, mode, 2);
+
+    spiWait();
+    SPI.beginTransaction(_spiSettings);
+    spiBurst(seq, count);
+    SPI.endTransaction();
+
+    // the wait happens lazily before the next instruction
+    _spi_sent = micros();
+    if ((mode == LOW) && (value == LCD_CLEARDISPLAY || (value & ~0x01) == LCD_RETURNHOME)) {
+      _spi_settle = LCD_SPI_SETTLE_LONG;
+    } else {
+      _spi_settle = LCD_SPI_SETTLE;
+    }
   }
 }
 
 void LiquidCrystal::pulseEnable(void) {
-  if (_usingSpi == false)
-  {
-    digitalWrite(_enable_pin, LOW);
-    delayMicroseconds(1);    
-    digitalWrite(_enable_pin, HIGH);
-    delayMicroseconds(1);    // enable pulse must be >450ns
-    digitalWrite(_enable_pin, LOW);
+  lcdPinWrite(_enable_out, _enable_mask, LOW);
+  delayMicroseconds(1);    
+  lcdPinWrite(_enable_out, _enable_mask, HIGH);
+  delayMicroseconds(1);    // enable pulse must be >450ns
+  lcdPinWrite(_enable_out, _enable_mask, LOW);
+  if (!_busyPolling && !_queued) {
     delayMicroseconds(100);   // commands need > 37us to settle
   }
-  else //we use SPI #############################################
-  {
-    bitWrite(_bitString, _enable_pin, LOW); 
-    spiSendOut();
-	delayMicroseconds(1); 
-	bitWrite(_bitString, _enable_pin, HIGH); 
-    spiSendOut();
-	delayMicroseconds(1);    // enable pulse must be >450ns
-	bitWrite(_bitString, _enable_pin, LOW); 
-    spiSendOut();
-	delayMicroseconds(40);   // commands need > 37us to settle
-  }
 }
 
 void LiquidCrystal::write4bits(uint8_t value) {
-  if (_usingSpi == false)
+  if (_usingI2c) //we use I2C ##############################################
   {
-    for (int i = 0; i < 4; i++) {
-      pinMode(_data_pins[i], OUTPUT);
-      digitalWrite(_data_pins[i], (value >> i) & 0x01);
-    }
+    // only used by the 4-bit initialisation, with RS low; begin() times
+    // its pauses from here, so wait until the nibble is out
+    i2cAppend(value << 4, LOW, 1);
+    i2cSubmit();
+    i2cWait();
+  }
+  else if (_usingSpi == false)
+  {
+    writeBus(value, 4);
+    pulseEnable();
   }
   else //we use SPI ##############################################
   {
-    for (int i = 4; i < 8; i++)
-	{
-	  //we put the four bits in the _bit_string
-	  bitWrite(_bitString, i, ((value >> (i - 4)) & 0x01)); 
-	}
-	//and send it out
-	spiSendOut();
+    // only used by the 4-bit initialisation, with RS low
+    uint8_t seq[LCD_SPI_SEQUENCE];
+    uint8_t count = lcdSpiSequence(seq, value << 4, LOW, 1);
+
+    spiWait();
+    SPI.beginTransaction(_spiSettings);
+    spiBurst(seq, count);
+    SPI.endTransaction();
+    _spi_sent = micros();
+    _spi_settle = LCD_SPI_SETTLE;
   }
-  pulseEnable();
 }
 
 void LiquidCrystal::write8bits(uint8_t value) {
-  for (int i = 0; i < 8; i++) {
-    pinMode(_data_pins[i], OUTPUT);
-    digitalWrite(_data_pins[i], (value >> i) & 0x01);
-  }
-  
+  writeBus(value, 8);
   pulseEnable();
 }
 
-void LiquidCrystal::spiSendOut() //SPI #############################
+// put the low 'width' bits of value on the data pins
+void LiquidCrystal::writeBus(uint8_t value, uint8_t width) {
+  if (_bus_out) {
+    uint8_t bits;
+    if (_bus_shift != 0xFF) {
+      bits = (value << _bus_shift) & _bus_mask;
+    } else {
+      bits = 0;
+      for (uint8_t i = 0; i < width; i++) {
+        if (value & (1 << i)) {
+          bits |= _data_mask[i];
+        }
+      }
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+    *_bus_out = (*_bus_out & ~_bus_mask) | bits;
+    SREG = oldSREG;
+  } else {
+    for (uint8_t i = 0; i < width; i++) {
+      lcdPinWrite(_data_out[i], _data_mask[i], (value >> i) & 0x01);
+    }
+  }
+}
+
+// Read the busy flag (bit 7) and the address counter (bits 0-6),
+// only possible on the parallel bus with the RW pin wired
+uint8_t LiquidCrystal::readStatus() {
+  uint8_t status = 0;
+  uint8_t width = (_displayfunction & LCD_8BITMODE) ? 8 : 4;
+
+  if (_bus_out) {
+    uint8_t oldSREG = SREG;
+    cli();
+    *_bus_ddr &= ~_bus_mask;
+    *_bus_out &= ~_bus_mask; // no pull-ups
+    SREG = oldSREG;
+  } else {
+    for (uint8_t i = 0; i < width; i++) {
+      pinMode(_data_pins[i], INPUT);
+    }
+  }
+  lcdPinWrite(_rs_out, _rs_mask, LOW);
+  lcdPinWrite(_rw_out, _rw_mask, HIGH);
+
+  // 8-bit mode reads everything at once, 4-bit mode high nibble first
+  for (uint8_t nibble = 0; nibble < 8 / width; nibble++) {
+    lcdPinWrite(_enable_out, _enable_mask, HIGH);
+    delayMicroseconds(1);    // data is valid 360ns after enable rises
+    status <<= width;
+    if (_bus_out && _bus_shift != 0xFF) {
+      status |= (*_bus_in & _bus_mask) >> _bus_shift;
+    } else {
+      for (uint8_t i = 0; i < width; i++) {
+        if (digitalRead(_data_pins[i])) {
+          status |= 1 << i;
+        }
+      }
+    }
+    lcdPinWrite(_enable_out, _enable_mask, LOW);
+    delayMicroseconds(1);
+  }
+
+  lcdPinWrite(_rw_out, _rw_mask, LOW);
+  if (_bus_out) {
+    uint8_t oldSREG = SREG;
+    cli();
+    *_bus_ddr |= _bus_mask;
+    SREG = oldSREG;
+  } else {
+    for (uint8_t i = 0; i < width; i++) {
+      pinMode(_data_pins[i], OUTPUT);
+    }
+  }
+
+  return status;
+}
+
+// Poll the busy flag until the controller accepts the next instruction.
+// If it never clears the flag is not usable (no RW line, broken wiring),
+// wait out the worst case instruction time and use the fixed delays
+// from now on.
+void LiquidCrystal::waitReady() {
+  unsigned long start = micros();
+
+  while (readStatus() & LCD_BUSYFLAG) {
+    if (micros() - start > LCD_BUSY_TIMEOUT) {
+      _busyPolling = false;
+      delayMicroseconds(2000);
+      return;
+    }
+  }
+}
+
+// Shift the states out back to back. The 74HC595 only shows a byte on its
+// outputs after a latch pulse, so every state gets its own latch edge.
+void LiquidCrystal::spiBurst(const uint8_t *seq, uint8_t count)
 {
-  //just in case you are using SPI for more then one device
-  //set bitOrder, clockDivider and dataMode each time
-  SPI.setClockDivider(_clockDivider); 
-  SPI.setBitOrder(_bitOrder);
-  SPI.setDataMode(_dataMode); 
-  
-  digitalWrite(_latchPin, LOW);
-  SPI.transfer(_bitString);
-  digitalWrite(_latchPin, HIGH); 
+  while (count--) {
+    SPI.transfer(*seq++);
+    lcdPinWrite(_latch_out, _latch_mask, LOW);
+    lcdPinWrite(_latch_out, _latch_mask, HIGH);
+  }
+}
+
+// Append the expander states of a byte or nibble, see lcdI2cSequence()
+void LiquidCrystal::i2cAppend(uint8_t value, uint8_t mode, uint8_t nibbles) //I2C ###
+{
+  if (_i2c->length + LCD_I2C_SEQUENCE > LCD_I2C_BUFFER) {
+    i2cSubmit();
+  }
+  if (_i2c->length == 0) {
+    i2cWait(); // the buffer is still on the bus
+  }
+
+  _i2c->length += lcdI2cSequence(&_i2c->buffer[_i2c->length], _i2c->state,
+                                _i2c->length != 0, value, mode, nibbles);
+}
+
+// wait until the last instruction has executed
+void LiquidCrystal::spiWait()
+{
+  while (micros() - _spi_sent < _spi_settle) {
+    ;
+  }
 }
\ No newline at end of file
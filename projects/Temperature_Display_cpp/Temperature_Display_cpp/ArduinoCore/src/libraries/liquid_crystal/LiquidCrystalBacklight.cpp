@@ -0,0 +1,218 @@
+#include "LiquidCrystalBacklight.h"
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "Arduino.h"
+
+// perceived brightness to PWM duty, x^2.2 sampled every 16 levels
+static const uint8_t gammaCurve[17] PROGMEM = {
+  0, 1, 3, 6, 12, 20, 29, 41, 55, 72, 91, 112, 135, 161, 190, 221, 255
+};
+
+static uint8_t gammaCorrect(uint8_t level)
+{
+  if (level == 255) {
+    return 255;
+  }
+
+  uint8_t i = level >> 4;
+  uint8_t low = pgm_read_byte(&gammaCurve[i]);
+  uint8_t high = pgm_read_byte(&gammaCurve[i + 1]);
+  return low + (((high - low) * (level & 0x0F)) >> 4);
+}
+
+// the backlight served by the Timer0 interrupt
+static LiquidCrystalBacklight *backlightOwner = 0;
+
+LiquidCrystalBacklight::LiquidCrystalBacklight(uint8_t pin) :
+  _pin(pin)
+{
+  _level = 0;
+  _rate = 0;
+  _target = 0;
+  _active = 0;
+  _duty = 0;
+  _idleTimeout = 0;
+  _idle = false;
+  _channel = 0xFF;
+}
+
+void LiquidCrystalBacklight::begin(uint8_t level)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _active = level;
+  _target = level;
+  _level = level << 8;
+  _rate = 0;
+  _lastTick = millis();
+  _lastActivity = _lastTick;
+  _idle = false;
+  backlightOwner = this;
+  SREG = oldSREG;
+
+  _duty = gammaCorrect(level);
+  analogWrite(_pin, _duty);
+
+  // Timer0 runs for millis() already, compare B adds a tick in each
+  // period without touching its setup
+  TIMSK0 |= _BV(OCIE0B);
+}
+
+void LiquidCrystalBacklight::end()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  TIMSK0 &= ~_BV(OCIE0B);
+  backlightOwner = 0;
+  SREG = oldSREG;
+}
+
+void LiquidCrystalBacklight::fadeTo(uint8_t level, unsigned int ms)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _active = level;
+  if (!_idle) {
+    aim(effectiveLevel(), ms);
+  }
+  SREG = oldSREG;
+}
+
+void LiquidCrystalBacklight::setIdle(unsigned long timeout, uint8_t floor, unsigned int ms)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _idleTimeout = timeout;
+  _floor = floor;
+  _idleFade = ms;
+  _lastActivity = millis();
+  SREG = oldSREG;
+}
+
+void LiquidCrystalBacklight::activity()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _lastActivity = millis();
+  if (_idle) {
+    _idle = false;
+    aim(effectiveLevel(), _idleFade);
+  }
+  SREG = oldSREG;
+}
+
+void LiquidCrystalBacklight::setAmbient(uint8_t channel, uint8_t dark)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  _channel = channel;
+  _dark = dark;
+  _ambient = 1023;
+  _lastSample = millis();
+  SREG = oldSREG;
+}
+
+void LiquidCrystalBacklight::update()
+{
+  if (_channel == 0xFF) {
+    return;
+  }
+
+  unsigned long now = millis();
+  if (now - _lastSample < LCD_BACKLIGHT_AMBIENT_PERIOD) {
+    return;
+  }
+  _lastSample = now;
+
+  int16_t sample = analogRead(_channel);
+
+  // light filtering against flicker of the room lights, the interrupt
+  // follows the new value on its next tick
+  uint8_t oldSREG = SREG;
+  cli();
+  _ambient += (sample - (int16_t)_ambient) >> 2;
+  SREG = oldSREG;
+}
+
+/************ interrupt side */
+
+// start moving towards target, ms for the distance to it; call with
+// interrupts off
+void LiquidCrystalBacklight::aim(uint8_t target, unsigned int ms)
+{
+  uint8_t current = _level >> 8;
+  uint16_t distance = (target > current) ? target - current : current - target;
+
+  _target = target;
+  if (ms < LCD_BACKLIGHT_TICK) {
+    _level = target << 8;
+    _rate = 0;
+    return;
+  }
+  _rate = ((uint32_t)distance << 8) * LCD_BACKLIGHT_TICK / ms;
+  if (_rate == 0) {
+    _rate = 1;
+  }
+}
+
+// level while awake, scaled down in a dark room
+uint8_t LiquidCrystalBacklight::effectiveLevel()
+{
+  if ((_channel == 0xFF) || (_active <= _dark)) {
+    return _active;
+  }
+  return _dark + (((uint32_t)(_active - _dark) * _ambient) >> 10);
+}
+
+void LiquidCrystalBacklight::_tick(void)
+{
+  unsigned long now = millis();
+
+  if (now - _lastTick < LCD_BACKLIGHT_TICK) {
+    return;
+  }
+  _lastTick = now;
+
+  if (!_idle && _idleTimeout && (now - _lastActivity >= _idleTimeout)) {
+    _idle = true;
+    aim(_floor, _idleFade);
+  } else if (!_idle && (_rate == 0)) {
+    // follow the room slowly
+    uint8_t target = effectiveLevel();
+    if (target != _target) {
+      aim(target, LCD_BACKLIGHT_FADE);
+    }
+  }
+
+  // one step towards the target
+  uint16_t target = _target << 8;
+  if (_level < target) {
+    _level = (target - _level > _rate) ? _level + _rate : target;
+  } else if (_level > target) {
+    _level = (_level - target > _rate) ? _level - _rate : target;
+  }
+  if (_level == target) {
+    _rate = 0;
+  }
+
+  output();
+}
+
+void LiquidCrystalBacklight::output()
+{
+  uint8_t duty = gammaCorrect(_level >> 8);
+
+  if (duty != _duty) {
+    _duty = duty;
+    analogWrite(_pin, duty);
+  }
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+  if (backlightOwner) {
+    backlightOwner->_tick();
+  }
+}
@@ -0,0 +1,206 @@
+#include "LiquidCrystalBuffer.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+#include "Arduino.h"
+#include "ClockScaling.h"
+
+LiquidCrystalBuffer::LiquidCrystalBuffer(LiquidCrystal &lcd) :
+  _lcd(lcd)
+{
+  begin(16, 1);
+}
+
+void LiquidCrystalBuffer::begin(uint8_t cols, uint8_t lines)
+{
+  _numcols = cols;
+  _numlines = lines;
+  _cursor = 0;
+
+  // a freshly cleared display is filled with spaces
+  memset(_cells, ' ', sizeof(_cells));
+  memset(_dirty, 0, sizeof(_dirty));
+  _shown_chars = 0;
+}
+
+/********** high level commands, for the user! */
+void LiquidCrystalBuffer::clear()
+{
+  for (uint8_t i = 0; i < LCD_DDRAM_SIZE; i++) {
+    setCell(i, ' ');
+  }
+  _cursor = 0;
+}
+
+void LiquidCrystalBuffer::home()
+{
+  _cursor = 0;
+}
+
+void LiquidCrystalBuffer::setCursor(uint8_t col, uint8_t row)
+{
+  _cursor = cellIndex(col, row);
+}
+
+size_t LiquidCrystalBuffer::write(uint8_t value)
+{
+  setCell(_cursor, value);
+
+  // the same way the display address counter moves, 2-line displays
+  // continue from the end of the first line to the second one
+  if (++_cursor == LCD_DDRAM_SIZE) {
+    _cursor = 0;
+  }
+  return 1;
+}
+
+size_t LiquidCrystalBuffer::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = size;
+  while (n--) {
+    write(*buffer++);
+  }
+  return size;
+}
+
+uint8_t LiquidCrystalBuffer::charAt(uint8_t col, uint8_t row)
+{
+  return _cells[cellIndex(col, row)];
+}
+
+uint8_t LiquidCrystalBuffer::customChars()
+{
+  uint8_t used = 0;
+
+  for (uint8_t i = 0; i < LCD_DDRAM_SIZE; i++) {
+    if (_cells[i] < 16) {
+      used |= 1 << (_cells[i] & 0x07);
+    }
+  }
+  return used;
+}
+
+void LiquidCrystalBuffer::invalidate()
+{
+  memset(_dirty, 0xFF, sizeof(_dirty));
+  _shown_chars = 0xFF; // whatever the display holds now
+}
+
+void LiquidCrystalBuffer::flush()
+{
+  uint8_t next = LCD_DDRAM_SIZE; // cell the display writes to next, unknown yet
+  uint8_t i;
+
+  _flush_chars = 0;
+  _flush_commands = 0;
+
+  for (i = 0; i < sizeof(_dirty); i++) {
+    if (_dirty[i]) {
+      break;
+    }
+  }
+  if (i == sizeof(_dirty)) {
+    return; // nothing changed
+  }
+
+  // keep the bus transfer short; queued bytes leave from the Timer2
+  // interrupt after flush() returned, a boost would not reach them
+  bool boost = !_lcd.queued();
+  if (boost) {
+    ClockScaling.request(clock_div_1);
+  }
+
+  i = 0;
+  while (i < LCD_DDRAM_SIZE) {
+    // skip 8 clean cells at once
+    if (_dirty[i >> 3] == 0) {
+      i = (i | 0x07) + 1;
+      continue;
+    }
+    if (!isDirty(i)) {
+      i++;
+      continue;
+    }
+
+    uint8_t start = i;
+    if (next != i) {
+      if ((next < i) && (i - next == 1)) {
+        // rewriting one clean cell costs the same as a cursor command
+        // and keeps the address counter moving forward
+        start = next;
+      } else {
+        _lcd.command(LCD_SETDDRAMADDR | cellAddress(i));
+        _flush_commands++;
+      }
+    }
+
+    // extend the run over the following dirty cells, and over single
+    // clean ones for the same reason, then send it in one piece so the
+    // serial transports can put it on the bus as one burst
+    uint8_t end = i + 1;
+    while (end < LCD_DDRAM_SIZE) {
+      if (isDirty(end)) {
+        end++;
+      } else if ((end + 1 < LCD_DDRAM_SIZE) && isDirty(end + 1)) {
+        end += 2;
+      } else {
+        break;
+      }
+    }
+
+    _lcd.write(&_cells[start], end - start);
+    _flush_chars += end - start;
+    next = end;
+    i = end;
+  }
+
+  memset(_dirty, 0, sizeof(_dirty));
+  _shown_chars = customChars();
+
+  if (boost) {
+    ClockScaling.release(clock_div_1);
+  }
+}
+
+/************ helpers **********/
+
+// Index of a cell in the DDRAM copy, the same layout as LiquidCrystal
+// uses for its row offsets
+uint8_t LiquidCrystalBuffer::cellIndex(uint8_t col, uint8_t row)
+{
+  uint8_t index;
+
+  if (_numlines < 2) {
+    index = col;
+  } else {
+    if (row >= _numlines) {
+      row = _numlines - 1;    // we count rows starting w/0
+    }
+    // rows 2 and 3 continue rows 0 and 1 right after the visible columns
+    index = (row & 0x01) ? LCD_DDRAM_LINE_SIZE : 0;
+    if (row & 0x02) {
+      index += _numcols;
+    }
+    index += col;
+  }
+
+  return (index < LCD_DDRAM_SIZE) ? index : LCD_DDRAM_SIZE - 1;
+}
+
+// DDRAM address of a cell, the second line starts at 0x40
+uint8_t LiquidCrystalBuffer::cellAddress(uint8_t index)
+{
+  if ((_numlines < 2) || (index < LCD_DDRAM_LINE_SIZE)) {
+    return index;
+  }
+  return 0x40 + index - LCD_DDRAM_LINE_SIZE;
+}
+
+void LiquidCrystalBuffer::setCell(uint8_t index, uint8_t value)
+{
+  if (_cells[index] != value) {
+    _cells[index] = value;
+    _dirty[index >> 3] |= 1 << (index & 0x07);
+  }
+}
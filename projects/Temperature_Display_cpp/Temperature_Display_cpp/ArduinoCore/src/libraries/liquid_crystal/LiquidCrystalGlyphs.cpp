@@ -0,0 +1,86 @@
+#include "LiquidCrystalGlyphs.h"
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "Arduino.h"
+
+LiquidCrystalGlyphs::LiquidCrystalGlyphs(LiquidCrystalBuffer &screen) :
+  _screen(screen)
+{
+  invalidate();
+}
+
+void LiquidCrystalGlyphs::invalidate()
+{
+  for (uint8_t i = 0; i < LCD_CGRAM_SLOTS; i++) {
+    _glyphs[i] = 0;
+    _lru[i] = LCD_CGRAM_SLOTS - 1 - i; // slot 0 is filled first
+  }
+  resetStats();
+}
+
+void LiquidCrystalGlyphs::resetStats()
+{
+  _hits = 0;
+  _uploads = 0;
+}
+
+uint8_t LiquidCrystalGlyphs::find(const uint8_t *glyph)
+{
+  for (uint8_t i = 0; i < LCD_CGRAM_SLOTS; i++) {
+    if (_glyphs[i] == glyph) {
+      return i;
+    }
+  }
+  return 0xFF;
+}
+
+uint8_t LiquidCrystalGlyphs::acquire(const uint8_t *glyph)
+{
+  uint8_t slot = find(glyph);
+
+  if (slot != 0xFF) {
+    _hits++;
+    touch(slot);
+    return slot;
+  }
+
+  // replace the least recently used slot no cell refers to, neither in
+  // the buffer nor on the display until the next flush(); that also
+  // protects custom characters the sketch printed by itself
+  uint8_t used = _screen.customChars() | _screen.shownCustomChars();
+  uint8_t i = LCD_CGRAM_SLOTS;
+  while (i--) {
+    if (!(used & (1 << _lru[i]))) {
+      break;
+    }
+  }
+  if (i == 0xFF) {
+    return 0xFF; // every slot is on the display
+  }
+
+  slot = _lru[i];
+  uint8_t bitmap[LCD_GLYPH_SIZE];
+  memcpy_P(bitmap, glyph, sizeof(bitmap));
+  _screen.display().createChar(slot, bitmap);
+  _glyphs[slot] = glyph;
+  _uploads++;
+
+  touch(slot);
+  return slot;
+}
+
+// move the slot to the front of the LRU list
+void LiquidCrystalGlyphs::touch(uint8_t slot)
+{
+  uint8_t i = 0;
+
+  while (_lru[i] != slot) {
+    i++;
+  }
+  for (; i > 0; i--) {
+    _lru[i] = _lru[i - 1];
+  }
+  _lru[0] = slot;
+}
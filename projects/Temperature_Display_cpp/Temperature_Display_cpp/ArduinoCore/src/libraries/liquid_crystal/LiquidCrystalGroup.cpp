@@ -0,0 +1,261 @@
+#include "LiquidCrystalGroup.h"
+
+#include <inttypes.h>
+
+#include "Arduino.h"
+
+LiquidCrystalGroup::LiquidCrystalGroup(uint8_t rs, uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7) :
+  _displays(0)
+{
+  _rs.attach(rs);
+  _data[0].attach(d4);
+  _data[1].attach(d5);
+  _data[2].attach(d6);
+  _data[3].attach(d7);
+}
+
+void LiquidCrystalGroup::attach(LiquidCrystalShared *display)
+{
+  display->_next = _displays;
+  _displays = display;
+}
+
+// How long a display is busy after an entry. After a warm reset the
+// power-on handshake only has to cover an instruction still executing.
+static unsigned int settleTime(uint8_t flags)
+{
+  if (flags & LCD_GROUP_WAKE) {
+    return LiquidCrystal::warmStart() ? LCD_WARM_LONG : 4500;
+  }
+  if (flags & LCD_GROUP_LONG) {
+    return LCD_GROUP_SETTLE_LONG;
+  }
+  return LCD_GROUP_SETTLE;
+}
+
+bool LiquidCrystalGroup::poll()
+{
+  bool pending = false;
+
+  for (LiquidCrystalShared *display = _displays; display; display = display->_next) {
+    uint8_t tail = display->_tail;
+    if (tail == display->_head) {
+      continue;
+    }
+    pending = true;
+
+    // still executing, serve the next display meanwhile
+    if (micros() - display->_sent < display->_settle) {
+      continue;
+    }
+
+    uint8_t flags = display->_flags[tail];
+    transfer(display->_queue[tail], flags, display->_enable);
+    display->_sent = micros();
+    display->_settle = settleTime(flags);
+    display->_tail = (tail + 1) % LCD_GROUP_QUEUE;
+  }
+  return pending;
+}
+
+void LiquidCrystalGroup::flush()
+{
+  while (poll()) {
+    ;
+  }
+}
+
+// put one byte (or its high nibble) on the shared lines and latch it into
+// the display with this enable line, the other displays ignore the bus
+void LiquidCrystalGroup::transfer(uint8_t value, uint8_t flags, LcdPin &enable)
+{
+  _rs.write(flags & LCD_GROUP_RS);
+
+  for (uint8_t i = 0; i < 4; i++) {
+    _data[i].write((value >> (i + 4)) & 0x01);
+  }
+  pulse(enable);
+
+  if (!(flags & LCD_GROUP_NIBBLE)) {
+    for (uint8_t i = 0; i < 4; i++) {
+      _data[i].write((value >> i) & 0x01);
+    }
+    pulse(enable);
+  }
+}
+
+void LiquidCrystalGroup::pulse(LcdPin &enable)
+{
+  enable.write(HIGH);
+  delayMicroseconds(1);    // enable pulse must be >450ns
+  enable.write(LOW);
+}
+
+/************ displays */
+
+LiquidCrystalShared::LiquidCrystalShared(LiquidCrystalGroup &group, uint8_t enable) :
+  _group(group), _head(0), _tail(0), _sent(0), _settle(0)
+{
+  _enable.attach(enable);
+  _group.attach(this);
+
+  _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  _numlines = 1;
+  _numcols = 16;
+}
+
+void LiquidCrystalShared::begin(uint8_t cols, uint8_t lines, uint8_t dotsize)
+{
+  _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  if (lines > 1) {
+    _displayfunction |= LCD_2LINE;
+  }
+  // for some 1 line displays you can select a 10 pixel high font
+  if ((dotsize != 0) && (lines == 1)) {
+    _displayfunction |= LCD_5x10DOTS;
+  }
+  _numlines = lines;
+  _numcols = cols;
+
+  // at least 40ms after power rises above 2.7V, counted from reset
+  unsigned long now = millis();
+  if (!LiquidCrystal::warmStart() && now < LCD_POWER_UP_TIME) {
+    delayMicroseconds((LCD_POWER_UP_TIME - now) * 1000);
+  }
+
+  // HD44780 datasheet figure 24: 8-bit mode three times, then 4-bit
+  send(0x30, LCD_GROUP_NIBBLE | LCD_GROUP_WAKE);
+  send(0x30, LCD_GROUP_NIBBLE | LCD_GROUP_WAKE);
+  send(0x30, LCD_GROUP_NIBBLE | LCD_GROUP_LONG);
+  send(0x20, LCD_GROUP_NIBBLE);
+
+  // finally, set # lines, font size, etc.
+  command(LCD_FUNCTIONSET | _displayfunction);
+
+  // turn the display on with no cursor or blinking default
+  _displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
+  display();
+
+  clear();
+
+  // Initialize to default text direction (for romance languages)
+  _displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+
+/********** high level commands, for the user! */
+void LiquidCrystalShared::clear()
+{
+  command(LCD_CLEARDISPLAY);
+}
+
+void LiquidCrystalShared::home()
+{
+  command(LCD_RETURNHOME);
+}
+
+void LiquidCrystalShared::setCursor(uint8_t col, uint8_t row)
+{
+  command(LCD_SETDDRAMADDR | lcdAddress(col, row, _numcols, _numlines));
+}
+
+void LiquidCrystalShared::noDisplay() {
+  _displaycontrol &= ~LCD_DISPLAYON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+void LiquidCrystalShared::display() {
+  _displaycontrol |= LCD_DISPLAYON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+
+void LiquidCrystalShared::noCursor() {
+  _displaycontrol &= ~LCD_CURSORON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+void LiquidCrystalShared::cursor() {
+  _displaycontrol |= LCD_CURSORON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+
+void LiquidCrystalShared::noBlink() {
+  _displaycontrol &= ~LCD_BLINKON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+void LiquidCrystalShared::blink() {
+  _displaycontrol |= LCD_BLINKON;
+  command(LCD_DISPLAYCONTROL | _displaycontrol);
+}
+
+void LiquidCrystalShared::scrollDisplayLeft(void) {
+  command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
+}
+void LiquidCrystalShared::scrollDisplayRight(void) {
+  command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
+}
+
+void LiquidCrystalShared::leftToRight(void) {
+  _displaymode |= LCD_ENTRYLEFT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+void LiquidCrystalShared::rightToLeft(void) {
+  _displaymode &= ~LCD_ENTRYLEFT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+
+void LiquidCrystalShared::autoscroll(void) {
+  _displaymode |= LCD_ENTRYSHIFTINCREMENT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+void LiquidCrystalShared::noAutoscroll(void) {
+  _displaymode &= ~LCD_ENTRYSHIFTINCREMENT;
+  command(LCD_ENTRYMODESET | _displaymode);
+}
+
+void LiquidCrystalShared::createChar(uint8_t location, const uint8_t charmap[]) {
+  location &= 0x7; // we only have 8 locations 0-7
+  command(LCD_SETCGRAMADDR | (location << 3));
+  for (uint8_t i = 0; i < 8; i++) {
+    write(charmap[i]);
+  }
+}
+
+/*********** mid level commands, for sending data/cmds */
+
+void LiquidCrystalShared::command(uint8_t value) {
+  // clear and home are the only instructions 0x01-0x03
+  send(value, (value & 0xFC) ? 0 : LCD_GROUP_LONG);
+}
+
+size_t LiquidCrystalShared::write(uint8_t value) {
+  send(value, LCD_GROUP_RS);
+  return 1;
+}
+
+void LiquidCrystalShared::flush()
+{
+  while (_head != _tail) {
+    _group.poll();
+  }
+}
+
+int LiquidCrystalShared::availableForWrite()
+{
+  return (LCD_GROUP_QUEUE - 1) - (uint8_t)(_head - _tail + LCD_GROUP_QUEUE) % LCD_GROUP_QUEUE;
+}
+
+void LiquidCrystalShared::send(uint8_t value, uint8_t flags)
+{
+  uint8_t next = (_head + 1) % LCD_GROUP_QUEUE;
+
+  // full, the displays ready meanwhile get their bytes
+  while (next == _tail) {
+    _group.poll();
+  }
+
+  _queue[_head] = value;
+  _flags[_head] = flags;
+  _head = next;
+
+  // keep the bytes moving while the sketch prints
+  _group.poll();
+}
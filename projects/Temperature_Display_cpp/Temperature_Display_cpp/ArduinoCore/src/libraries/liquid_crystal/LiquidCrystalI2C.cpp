@@ -0,0 +1,83 @@
+#include "LiquidCrystal.h"
+
+#include <inttypes.h>
+
+#include "Arduino.h"
+#include "Twi.h"
+
+// The TWI side of the PCF8574 transport. LiquidCrystal.cpp only reaches
+// it through _i2c_transport, which the I2C constructor below sets: a
+// sketch using another transport never refers to this file, and the
+// TWI driver and its interrupt stay out of the build.
+
+const LiquidCrystal::I2cTransport LiquidCrystal::i2cTwi = {
+  LiquidCrystal::i2cTwiSubmit,
+  LiquidCrystal::i2cTwiWait
+};
+
+// 2
+LiquidCrystal::LiquidCrystal(LcdI2cState &state, TwiMasterClass &twi, uint8_t address) : //I2C
+  _usingSpi(false), _usingI2c(true), _i2c(&state)
+{
+  _i2c->twi = &twi;
+  initI2C(address);
+  //expander pins 0,1,2,4,5,6,7 represent rs, rw, enable, d4-7, pin 3 is
+  //the backlight; RW stays low
+  init(1, 0, 255, 2, 0, 0, 0, 0, 4, 5, 6, 7, 255);
+}
+
+void LiquidCrystal::initI2C(uint8_t address) //I2C ##########################
+{
+  _usingSpi = false;
+  _usingI2c = true;
+  _i2c_transport = &i2cTwi;
+
+  _i2c->tx.address = address;
+  _i2c->tx.rxData = 0;
+  _i2c->tx.rxLength = 0;
+  _i2c->tx.callback = i2cComplete;
+  _i2c->tx.context = _i2c;
+  _i2c->tx.status = TWI_OK;
+  _i2c->state = LCD_I2C_BL;
+  _i2c->length = 0;
+  _i2c->batch = false;
+  _i2c->done = 0;
+  _i2c->settle = 0;
+
+  //the PCF8574 is specified up to 100kHz, most handle 400kHz
+  _i2c->twi->begin(TWI_FREQ_FAST);
+}
+
+void LiquidCrystal::i2cTwiSubmit(LiquidCrystal *lcd)
+{
+  LcdI2cState *i2c = lcd->_i2c;
+
+  if (i2c->length == 0) {
+    return;
+  }
+
+  i2c->tx.txData = i2c->buffer;
+  i2c->tx.txLength = i2c->length;
+  i2c->settle = 0;
+  i2c->twi->submit(&i2c->tx);
+  i2c->length = 0;
+}
+
+// until the last transaction finished and its last instruction executed
+void LiquidCrystal::i2cTwiWait(LiquidCrystal *lcd)
+{
+  LcdI2cState *i2c = lcd->_i2c;
+
+  i2c->twi->wait(&i2c->tx);
+  if (i2c->settle) {
+    while (micros() - i2c->done < i2c->settle) {
+      ;
+    }
+    i2c->settle = 0;
+  }
+}
+
+void LiquidCrystal::i2cComplete(TwiTransaction *transaction)
+{
+  ((LcdI2cState *)transaction->context)->done = micros();
+}
@@ -0,0 +1,148 @@
+#include "LiquidCrystalTemplate.h"
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "Arduino.h"
+
+LiquidCrystalTemplate::LiquidCrystalTemplate(LiquidCrystalBuffer &buffer) :
+  _buffer(buffer), _count(0)
+{
+}
+
+uint8_t LiquidCrystalTemplate::show(const char *layout)
+{
+  uint8_t col = 0;
+  uint8_t row = 0;
+  char c;
+
+  _buffer.clear();
+  _count = 0;
+
+  while ((c = pgm_read_byte(layout)) != 0) {
+    if (c == '\n') {
+      row++;
+      col = 0;
+      layout++;
+      continue;
+    }
+
+    if (c != LCD_TEMPLATE_DIGIT) {
+      _buffer.setCursor(col, row);
+      _buffer.write(c);
+      col++;
+      layout++;
+      continue;
+    }
+
+    // a field: digits, at most one decimal point between two of them,
+    // the tag in place of the second digit
+    Field field = { col, row, 0, 0, 0 };
+    bool point = false;
+    for (;;) {
+      c = pgm_read_byte(layout);
+      char next = pgm_read_byte(layout + 1);
+      if (c == LCD_TEMPLATE_DIGIT) {
+        if (point) {
+          field.fraction++;
+        }
+      } else if (field.width == 1 && c >= 'a' && c <= 'z' &&
+                 (next == LCD_TEMPLATE_DIGIT || next == '.')) {
+        field.tag = c;
+      } else if (c == '.' && !point &&
+                 next == LCD_TEMPLATE_DIGIT) {
+        point = true;
+      } else {
+        break;
+      }
+      field.width++;
+      layout++;
+    }
+    col += field.width;
+
+    if (field.width > LCD_TEMPLATE_FIELD_WIDTH) {
+      field.width = LCD_TEMPLATE_FIELD_WIDTH;
+    }
+    if (_count < LCD_TEMPLATE_FIELDS) {
+      _fields[_count++] = field;
+    }
+  }
+
+  return _count;
+}
+
+// numbers stay below LCD_TEMPLATE_FIELDS, tags start at 'a'
+const LiquidCrystalTemplate::Field *LiquidCrystalTemplate::find(uint8_t field)
+{
+  if (field < _count) {
+    return &_fields[field];
+  }
+  for (uint8_t i = 0; i < _count; i++) {
+    if (_fields[i].tag && (uint8_t)_fields[i].tag == field) {
+      return &_fields[i];
+    }
+  }
+  return 0;
+}
+
+void LiquidCrystalTemplate::set(uint8_t field, long value)
+{
+  const Field *found = find(field);
+  if (!found) {
+    return;
+  }
+
+  const Field &f = *found;
+  char cells[LCD_TEMPLATE_FIELD_WIDTH];
+  uint8_t pos = f.width;
+  uint8_t digits = 0;
+  bool negative = value < 0;
+  unsigned long v = negative ? -(unsigned long)value : value;
+
+  // from the right, at least one digit before the decimal point
+  do {
+    if (f.fraction && digits == f.fraction) {
+      if (pos == 0) {
+        break;
+      }
+      cells[--pos] = '.';
+    }
+    if (pos == 0) {
+      break;
+    }
+    cells[--pos] = '0' + v % 10;
+    v /= 10;
+    digits++;
+  } while (v || digits <= f.fraction);
+
+  if (negative && pos) {
+    cells[--pos] = '-';
+    negative = false;
+  }
+  if (v || negative || digits <= f.fraction) {
+    fill(f, '-');
+    return;
+  }
+  while (pos) {
+    cells[--pos] = ' ';
+  }
+
+  _buffer.setCursor(f.col, f.row);
+  _buffer.write((const uint8_t *)cells, f.width);
+}
+
+void LiquidCrystalTemplate::setUnknown(uint8_t field)
+{
+  const Field *f = find(field);
+  if (f) {
+    fill(*f, '-');
+  }
+}
+
+void LiquidCrystalTemplate::fill(const Field &f, char c)
+{
+  _buffer.setCursor(f.col, f.row);
+  for (uint8_t i = 0; i < f.width; i++) {
+    _buffer.write(c);
+  }
+}
@@ -0,0 +1,211 @@
+#include "LiquidCrystalWidgets.h"
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+
+#include "Arduino.h"
+
+// full block in the character ROM
+#define LCD_FULL_BLOCK 0xFF
+
+/************ glyph set */
+
+// upper bar, lower bar, both; with the full block they make up the numerals
+static const uint8_t bigUpper[LCD_GLYPH_SIZE] PROGMEM = {
+  0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+static const uint8_t bigLower[LCD_GLYPH_SIZE] PROGMEM = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F
+};
+static const uint8_t bigBoth[LCD_GLYPH_SIZE] PROGMEM = {
+  0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x1F, 0x1F, 0x1F
+};
+
+// 1 to 4 columns of a bar cell, 5 is the full block
+static const uint8_t barGlyphs[4][LCD_GLYPH_SIZE] PROGMEM = {
+  { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },
+  { 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18 },
+  { 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C },
+  { 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E }
+};
+
+// cell codes of the numeral font
+#define BIG_SPACE 0
+#define BIG_UPPER 1
+#define BIG_LOWER 2
+#define BIG_BOTH  3
+#define BIG_FULL  4
+
+// '0'-'9', '-', ' ': top row then bottom row
+static const uint8_t bigFont[12][2 * LCD_BIGNUMBER_WIDTH] PROGMEM = {
+  { BIG_FULL,  BIG_UPPER, BIG_FULL,  BIG_FULL,  BIG_LOWER, BIG_FULL  },
+  { BIG_UPPER, BIG_FULL,  BIG_SPACE, BIG_LOWER, BIG_FULL,  BIG_LOWER },
+  { BIG_BOTH,  BIG_BOTH,  BIG_FULL,  BIG_FULL,  BIG_LOWER, BIG_LOWER },
+  { BIG_UPPER, BIG_BOTH,  BIG_FULL,  BIG_LOWER, BIG_LOWER, BIG_FULL  },
+  { BIG_FULL,  BIG_LOWER, BIG_FULL,  BIG_SPACE, BIG_SPACE, BIG_FULL  },
+  { BIG_FULL,  BIG_BOTH,  BIG_BOTH,  BIG_LOWER, BIG_LOWER, BIG_FULL  },
+  { BIG_FULL,  BIG_BOTH,  BIG_BOTH,  BIG_FULL,  BIG_LOWER, BIG_FULL  },
+  { BIG_UPPER, BIG_UPPER, BIG_FULL,  BIG_SPACE, BIG_SPACE, BIG_FULL  },
+  { BIG_FULL,  BIG_BOTH,  BIG_FULL,  BIG_FULL,  BIG_LOWER, BIG_FULL  },
+  { BIG_FULL,  BIG_BOTH,  BIG_FULL,  BIG_LOWER, BIG_LOWER, BIG_FULL  },
+  { BIG_LOWER, BIG_LOWER, BIG_LOWER, BIG_SPACE, BIG_SPACE, BIG_SPACE },
+  { BIG_SPACE, BIG_SPACE, BIG_SPACE, BIG_SPACE, BIG_SPACE, BIG_SPACE }
+};
+
+/************ large numerals */
+
+LiquidCrystalBigNumber::LiquidCrystalBigNumber(LiquidCrystalGlyphs &glyphs, uint8_t col, uint8_t row,
+                                               uint8_t digits, uint8_t fraction) :
+  _glyphs(glyphs),
+  _col(col),
+  _row(row)
+{
+  _digits = (digits > LCD_BIGNUMBER_DIGITS) ? LCD_BIGNUMBER_DIGITS : digits;
+  _fraction = (fraction < _digits) ? fraction : 0;
+  invalidate();
+}
+
+void LiquidCrystalBigNumber::invalidate()
+{
+  memset(_shown, 0, sizeof(_shown));
+}
+
+void LiquidCrystalBigNumber::show(long value)
+{
+  LiquidCrystalBuffer &screen = _glyphs.screen();
+  char text[LCD_BIGNUMBER_DIGITS];
+  bool negative = (value < 0);
+  unsigned long v = negative ? -(unsigned long)value : value;
+
+  // right to left, leading zeros only up to the decimal point
+  for (uint8_t pos = _digits; pos-- > 0; ) {
+    if ((v != 0) || (pos >= _digits - _fraction - 1)) {
+      text[pos] = '0' + v % 10;
+      v /= 10;
+    } else if (negative) {
+      text[pos] = '-';
+      negative = false;
+    } else {
+      text[pos] = ' ';
+    }
+  }
+  if ((v != 0) || negative) {
+    memset(text, '-', _digits); // does not fit
+  }
+
+  // first time: the gaps and the decimal point
+  if (_shown[0] == 0) {
+    for (uint8_t pos = 1; pos < _digits; pos++) {
+      uint8_t col = _col + pos * (LCD_BIGNUMBER_WIDTH + 1) - 1;
+      screen.setCursor(col, _row);
+      screen.write(' ');
+      screen.setCursor(col, _row + 1);
+      screen.write((_fraction && (pos == _digits - _fraction)) ? '.' : ' ');
+    }
+  }
+
+  // only the digits which changed
+  for (uint8_t pos = 0; pos < _digits; pos++) {
+    if (text[pos] != _shown[pos]) {
+      drawChar(pos, text[pos]);
+      _shown[pos] = text[pos];
+    }
+  }
+}
+
+void LiquidCrystalBigNumber::drawChar(uint8_t pos, char c)
+{
+  LiquidCrystalBuffer &screen = _glyphs.screen();
+  uint8_t index = (c == '-') ? 10 : (c == ' ') ? 11 : c - '0';
+  uint8_t col = _col + pos * (LCD_BIGNUMBER_WIDTH + 1);
+
+  for (uint8_t line = 0; line < 2; line++) {
+    screen.setCursor(col, _row + line);
+    for (uint8_t i = 0; i < LCD_BIGNUMBER_WIDTH; i++) {
+      screen.write(cellChar(pgm_read_byte(&bigFont[index][line * LCD_BIGNUMBER_WIDTH + i])));
+    }
+  }
+}
+
+// character for a font cell, the full block if no CGRAM slot is free
+uint8_t LiquidCrystalBigNumber::cellChar(uint8_t code)
+{
+  const uint8_t *glyph;
+
+  switch (code) {
+  case BIG_SPACE: return ' ';
+  case BIG_UPPER: glyph = bigUpper; break;
+  case BIG_LOWER: glyph = bigLower; break;
+  case BIG_BOTH:  glyph = bigBoth; break;
+  default:        return LCD_FULL_BLOCK;
+  }
+
+  uint8_t slot = _glyphs.acquire(glyph);
+  return (slot != 0xFF) ? slot : LCD_FULL_BLOCK;
+}
+
+/************ bar */
+
+LiquidCrystalBar::LiquidCrystalBar(LiquidCrystalGlyphs &glyphs, uint8_t col, uint8_t row,
+                                   uint8_t width) :
+  _glyphs(glyphs),
+  _col(col),
+  _row(row),
+  _width(width)
+{
+  invalidate();
+}
+
+void LiquidCrystalBar::invalidate()
+{
+  _steps = 0xFFFF;
+}
+
+void LiquidCrystalBar::show(unsigned int value, unsigned int max)
+{
+  unsigned int total = _width * 5;
+  unsigned int steps;
+  uint8_t first, last;
+
+  if ((max == 0) || (value >= max)) {
+    steps = (max == 0) ? 0 : total;
+  } else {
+    steps = (unsigned long)value * total / max;
+  }
+  if (steps == _steps) {
+    return;
+  }
+
+  // only the cells between the old and the new end of the bar change
+  if (_steps == 0xFFFF) {
+    first = 0;
+    last = _width - 1;
+  } else {
+    first = ((steps < _steps) ? steps : _steps) / 5;
+    last = ((steps > _steps) ? steps : _steps) / 5;
+    if (last >= _width) {
+      last = _width - 1;
+    }
+  }
+
+  _glyphs.screen().setCursor(_col + first, _row);
+  for (uint8_t cell = first; cell <= last; cell++) {
+    drawCell(cell, steps);
+  }
+  _steps = steps;
+}
+
+void LiquidCrystalBar::drawCell(uint8_t cell, unsigned int steps)
+{
+  LiquidCrystalBuffer &screen = _glyphs.screen();
+  unsigned int start = cell * 5;
+  uint8_t c = ' ';
+
+  if (steps >= start + 5) {
+    c = LCD_FULL_BLOCK;
+  } else if (steps > start) {
+    uint8_t slot = _glyphs.acquire(barGlyphs[steps - start - 1]);
+    c = (slot != 0xFF) ? slot : LCD_FULL_BLOCK;
+  }
+  screen.write(c);
+}
@@ -19,6 +19,8 @@ uint8_t SPIClass::initialized = 0;
 uint8_t SPIClass::interruptMode = 0;
 uint8_t SPIClass::interruptMask = 0;
 uint8_t SPIClass::interruptSave = 0;
+uint8_t SPIClass::clockSetting = 0;
+uint8_t SPIClass::clockShift = 0;
 #ifdef SPI_TRANSACTION_MISMATCH_LED
 uint8_t SPIClass::inTransactionFlag = 0;
 #endif
@@ -58,6 +60,11 @@ void SPIClass::begin()
     // http://code.google.com/p/arduino/issues/detail?id=888
     pinMode(SCK, OUTPUT);
     pinMode(MOSI, OUTPUT);
+
+    clockSetting = clockBits(SPCR, SPSR);
+    clockShift = getClockPrescale();
+    if (clockShift) rescaleClock();
+    attachClockPrescaleHandler(clockPrescaleChanged);
   }
   initialized++; // reference count
   SREG = sreg;
@@ -198,4 +205,35 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber)
   if (!interruptMask)
     interruptMode = 0;
   SREG = sreg;
-}
\ No newline at end of file
+}
+
+void SPIClass::clockPrescaleChanged(uint8_t phase)
+{
+  if (phase != CLOCK_PRESCALE_AFTER)
+    return;
+
+  uint8_t sreg = SREG;
+  noInterrupts();
+  clockShift = getClockPrescale();
+  if (SPCR & _BV(SPE)) {
+    rescaleClock();
+  }
+  SREG = sreg;
+}
+
+void SPIClass::rescaleClock()
+{
+  // Decode the divider as a power of two
+  uint8_t clockDiv = clockSetting;
+  int8_t exponent = (clockDiv >= 6) ? clockDiv : clockDiv + 1;
+
+  exponent -= clockShift;
+  if (exponent < 1) exponent = 1;
+  if (exponent > 7) exponent = 7;
+
+  // fosc/64 is encoded twice, use the one with SPI2X cleared
+  clockDiv = (exponent == 7) ? 7 : exponent - 1;
+
+  SPCR = (SPCR & ~SPI_CLOCK_MASK) | ((clockDiv >> 1) & SPI_CLOCK_MASK);
+  SPSR = (SPSR & ~SPI_2XCLOCK_MASK) | (~clockDiv & SPI_2XCLOCK_MASK);
+}
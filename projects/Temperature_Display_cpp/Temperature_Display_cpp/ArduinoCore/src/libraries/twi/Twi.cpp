@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2018 by Krzysztof Wisniewski
+ * Interrupt driven TWI (I2C) master for arduino.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "Twi.h"
+
+#include <util/twi.h>
+
+TwiMasterClass TwiMaster;
+
+TwiTransaction * volatile TwiMasterClass::queueHead = 0;
+TwiTransaction *TwiMasterClass::queueTail = 0;
+uint32_t TwiMasterClass::frequency = TWI_FREQ_STANDARD;
+uint8_t TwiMasterClass::index = 0;
+uint8_t TwiMasterClass::reading = 0;
+uint8_t TwiMasterClass::retries = 0;
+bool TwiMasterClass::completing = false;
+unsigned long TwiMasterClass::started = 0;
+
+// TWCR values, the interrupt stays enabled throughout
+#define TWCR_IDLE   (_BV(TWEN) | _BV(TWIE))
+#define TWCR_NEXT   (_BV(TWINT) | TWCR_IDLE)
+#define TWCR_ACK    (TWCR_NEXT | _BV(TWEA))
+#define TWCR_START  (TWCR_NEXT | _BV(TWSTA))
+#define TWCR_STOP   (TWCR_NEXT | _BV(TWSTO))
+
+void TwiMasterClass::begin(uint32_t freq)
+{
+  recover();
+
+  // internal pull-ups, real designs need external ones for 400kHz
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+
+  queueHead = queueTail = 0;
+  setClock(freq);
+  TWCR = TWCR_IDLE;
+
+  attachClockPrescaleHandler(clockPrescaleChanged);
+}
+
+void TwiMasterClass::end()
+{
+  detachClockPrescaleHandler(clockPrescaleChanged);
+  TWCR = 0;
+  digitalWrite(SDA, LOW);
+  digitalWrite(SCL, LOW);
+}
+
+// SCL = CPU clock / (16 + 2 * TWBR * prescaler), with prescaler 1; a
+// divided system clock caps the bus speed
+void TwiMasterClass::setClock(uint32_t freq)
+{
+  uint32_t clock = getClockFrequency();
+  uint32_t twbr = 0;
+
+  frequency = freq;
+  if (clock / freq > 16) {
+    twbr = (clock / freq - 16 + 1) / 2;  // round down the bus speed
+  }
+  TWSR = 0;
+  TWBR = (twbr > 255) ? 255 : twbr;
+}
+
+void TwiMasterClass::clockPrescaleChanged(uint8_t phase)
+{
+  if (phase == CLOCK_PRESCALE_AFTER) {
+    setClock(frequency);
+  }
+}
+
+bool TwiMasterClass::submit(TwiTransaction *transaction)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+
+  for (TwiTransaction *t = queueHead; t; t = t->next) {
+    if (t == transaction) {
+      SREG = oldSREG;
+      return false;
+    }
+  }
+
+  transaction->status = TWI_PENDING;
+  transaction->next = 0;
+  if (queueHead) {
+    queueTail->next = transaction;
+    queueTail = transaction;
+  } else {
+    queueHead = queueTail = transaction;
+    // from a callback the state machine starts it, with the STOP of the
+    // finished transaction and in its single write of TWCR
+    if (!completing) {
+      TWCR = startNext();
+    }
+  }
+
+  SREG = oldSREG;
+  return true;
+}
+
+void TwiMasterClass::wait(TwiTransaction *transaction)
+{
+  while (transaction->status == TWI_PENDING) {
+    if (bit_is_clear(SREG, SREG_I)) {
+      if (TWCR & _BV(TWINT)) {
+        TWCR = step(TW_STATUS, TWDR);
+      }
+    } else {
+      poll();
+    }
+  }
+}
+
+void TwiMasterClass::poll()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  if (queueHead && (millis() - started > TWI_TIMEOUT)) {
+    TWCR = 0;
+    SREG = oldSREG;
+
+    recover();
+
+    cli();
+    TWCR = TWCR_IDLE;
+    uint8_t twcr = finish(TWI_TIMEOUT_ERROR);
+    // finish() chains a STOP, the bus was already released above
+    TWCR = twcr & ~_BV(TWSTO);
+  }
+  SREG = oldSREG;
+}
+
+// Up to 9 clocks make any device that still sends data release SDA,
+// then a STOP leaves the bus idle. The TWI must be off.
+void TwiMasterClass::recover()
+{
+  uint8_t twcr = TWCR;
+  TWCR = 0;
+
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+  delayMicroseconds(5);
+  for (uint8_t i = 0; i < 9 && !digitalRead(SDA); i++) {
+    digitalWrite(SCL, LOW);  // pull-up off first, then drive it low
+    pinMode(SCL, OUTPUT);
+    delayMicroseconds(5);
+    pinMode(SCL, INPUT_PULLUP);
+    delayMicroseconds(5);
+  }
+
+  // STOP: SDA rises while SCL is high
+  digitalWrite(SDA, LOW);
+  pinMode(SDA, OUTPUT);
+  delayMicroseconds(5);
+  pinMode(SDA, INPUT_PULLUP);
+  delayMicroseconds(5);
+
+  TWCR = twcr;
+}
+
+/************ state machine */
+
+// START for the head of the queue, or nothing when it is empty
+uint8_t TwiMasterClass::startNext()
+{
+  TwiTransaction *t = queueHead;
+
+  if (!t) {
+    return TWCR_IDLE;
+  }
+  retries = 0;
+  reading = (t->txLength == 0) && (t->rxLength != 0);
+  started = millis();
+  return TWCR_START;
+}
+
+// take the head off the queue and report it; whatever the callback
+// submits is only queued
+void TwiMasterClass::complete(uint8_t status)
+{
+  TwiTransaction *t = queueHead;
+
+  queueHead = t->next;
+  t->next = 0;
+  t->status = status;
+  if (t->callback) {
+    completing = true;
+    t->callback(t);
+    completing = false;
+  }
+}
+
+// complete the head of the queue, STOP and START the next one together
+uint8_t TwiMasterClass::finish(uint8_t status)
+{
+  complete(status);
+
+  uint8_t twcr = startNext();
+  return (twcr == TWCR_IDLE) ? TWCR_STOP : (twcr | _BV(TWSTO));
+}
+
+uint8_t TwiMasterClass::step(uint8_t status, volatile uint8_t &data)
+{
+  TwiTransaction *t = queueHead;
+
+  if (!t) {
+    // nothing of ours, release the bus
+    return (status == TW_BUS_ERROR) ? TWCR_STOP : TWCR_NEXT;
+  }
+
+  switch (status) {
+  case TW_START:
+  case TW_REP_START:
+    index = 0;
+    data = (t->address << 1) | (reading ? TW_READ : TW_WRITE);
+    return TWCR_NEXT;
+
+  // write phase
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if (index < t->txLength) {
+      data = t->txData[index++];
+      return TWCR_NEXT;
+    }
+    if (t->rxLength) {
+      reading = 1;
+      return TWCR_START;  // repeated START, keep the bus
+    }
+    return finish(TWI_OK);
+
+  case TW_MT_SLA_NACK:
+  case TW_MR_SLA_NACK:
+    return finish(TWI_NACK_ADDRESS);
+
+  case TW_MT_DATA_NACK:
+    return finish(TWI_NACK_DATA);
+
+  // read phase, NACK the last byte to end it
+  case TW_MR_DATA_ACK:
+    t->rxData[index++] = data;
+    // fall through
+  case TW_MR_SLA_ACK:
+    return (index + 1 < t->rxLength) ? TWCR_ACK : TWCR_NEXT;
+
+  case TW_MR_DATA_NACK:
+    t->rxData[index++] = data;
+    return finish(TWI_OK);
+
+  // another master won, START again once the bus is free
+  case TW_MT_ARB_LOST:
+    if (retries++ < TWI_ARBITRATION_RETRIES) {
+      reading = (t->txLength == 0) && (t->rxLength != 0);
+      return TWCR_START;
+    }
+    complete(TWI_ARBITRATION_LOST);
+    // the bus belongs to the other master, no STOP
+    return startNext() == TWCR_IDLE ? TWCR_NEXT : TWCR_START;
+
+  // illegal START/STOP, STOP releases the hardware
+  case TW_BUS_ERROR:
+  default:
+    return finish(TWI_BUS_ERROR);
+  }
+}
+
+ISR(TWI_vect)
+{
+  TWCR = TwiMasterClass::step(TW_STATUS, TWDR);
+}
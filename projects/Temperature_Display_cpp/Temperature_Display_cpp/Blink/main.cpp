@@ -7,9 +7,14 @@
 //End of Auto generated function prototypes by Atmel Studio
 
 #include "LiquidCrystal.h"
+#include "LiquidCrystalBuffer.h"
+#include "LiquidCrystalBacklight.h"
+#include "LiquidCrystalTemplate.h"
 #include "src/dht/DHT.h"
+#include "src/filter/filter.h"
 
 #include <avr/power.h>
+#include <ClockScaling.h>
 
 // what digital pin we're connected to
 // #define DHTPIN 13
@@ -22,18 +27,51 @@
 // initialize the library with the numbers of the interface pins
 LiquidCrystal lcd(8, 9, 4, 5, 6, 7, 10);
 
+// RAM copy of the LCD, only the changed characters are sent on flush
+LiquidCrystalBuffer screen(lcd);
+
+// The labels of both sensors, kept in flash and drawn once. Sensor 0 is
+// laid out on page 0 of the 40 column DDRAM, sensor 1 on page 1 (columns
+// 16-31), switching pages only moves the display window. Readings are
+// in tenths, each field is named by the letter after its first '#'.
+const char sensorLayout[] PROGMEM =
+	"Hum 0: #h#.# %  Hum 1: #i#.# %\n"
+	"Temp 0: #t#.# *CTemp 1: #u#.# *C";
+
+// the tags of the sensorLayout fields
+enum { HUM_0 = 'h', HUM_1 = 'i', TEMP_0 = 't', TEMP_1 = 'u' };
+#define SENSOR_FIELDS 4
+
+LiquidCrystalTemplate sensors(screen);
+
+// backlight on pin 10, fades in the background
+LiquidCrystalBacklight backlight(10);
+
 // Initialize DHT sensor.
 DHT dht_0(2, DHT11);
 DHT dht_1(13, DHT22);
 
+// Filter settings, values are in tenths of a unit.
+// DHT11 has 1 unit resolution, DHT22 0.1 unit resolution.
+//                                   median, ema shift, max delta, max rejects
+const filterConfig_t dht11_filter = {3,      1,         50,        3};
+const filterConfig_t dht22_filter = {3,      2,         20,        3};
+
+// Humidity and temperature filters for both sensors.
+filter_t hum_filter_0, temp_filter_0;
+filter_t hum_filter_1, temp_filter_1;
+
 int main() {
 	float h;
 	float t;
+	int16_t filtered;
 	
 	// Initialize ArduinoUNO
 	init();
 	
-	clock_prescale_set(clock_div_2);
+	// run at a quarter of the speed unless a driver asks for more,
+	// timekeeping and peripherals follow the clock changes
+	ClockScaling.begin(clock_div_4);
 	
 	// set up the LCD's number of columns and rows:
 	lcd.begin(16, 2);
@@ -45,15 +83,36 @@ int main() {
 	dht_0.begin();
 	dht_1.begin();
 	
+	// setup filters
+	filter_init(&hum_filter_0, &dht11_filter);
+	filter_init(&temp_filter_0, &dht11_filter);
+	filter_init(&hum_filter_1, &dht22_filter);
+	filter_init(&temp_filter_1, &dht22_filter);
+	
 	// print out a startup information
 	lcd.clear();
 	lcd.blink();
 	lcd.setCursor(0, 0);
 	lcd.print("Initializing...");
+	// boot to first text, to check the warm start path of begin()
+	unsigned long firstText = micros();
 	Serial.print("\rInitializing...\n");
-	lcd.backlight(100);
+	Serial.format(F("%s start, LCD text after %lu us\n"),
+		lcd.warmStart() ? F("Warm") : F("Cold"), firstText);
+	backlight.begin(0);
+	backlight.fadeTo(100);
+	// nobody watches the display most of the time, dim it after a minute
+	backlight.setIdle(60000UL, 10);
 	lcd.noBlink();
 	lcd.clear();
+	screen.begin(16, 2);
+	if (sensors.show(sensorLayout) != SENSOR_FIELDS) {
+		Serial.print(F("sensorLayout: field count does not match\n"));
+	}
+	screen.flush();
+	
+	// hand the bus transfers to the timer interrupt, prints return at once
+	lcd.beginQueue();
 
 	while (true) {
 		// Reading temperature or humidity takes about 250 milliseconds!
@@ -65,17 +124,21 @@ int main() {
 		// Check if any reads failed and exit early (to try again).
 		if (isnan(h) || isnan(t)) {
 			Serial.println("Failed to read from DHT sensor!");
+			// dashes rather than a stale reading
+			sensors.setUnknown(HUM_0);
+			sensors.setUnknown(TEMP_0);
 		} else {
-			lcd.setCursor(0, 0);
-			lcd.print("Hum 0: ");
-			lcd.print(h);
-			lcd.print(" %");
-			lcd.setCursor(0, 1);
-			lcd.print("Temp 0: ");
-			lcd.print(t);
-			lcd.print(" *C ");		
+			filter_push(&hum_filter_0, (int16_t)round(h * 10), &filtered);
+			sensors.set(HUM_0, filtered);
+			filter_push(&temp_filter_0, (int16_t)round(t * 10), &filtered);
+			sensors.set(TEMP_0, filtered);
 		}
 		
+		// send only what changed, at full speed
+		screen.flush();
+		
+		lcd.showPage(0);
+		
 		delay(2000);
 		
 		// Reading temperature or humidity takes about 250 milliseconds!
@@ -87,17 +150,21 @@ int main() {
 		// Check if any reads failed and exit early (to try again).
 		if (isnan(h) || isnan(t)) {
 			Serial.println("Failed to read from DHT sensor!");
+			// dashes rather than a stale reading
+			sensors.setUnknown(HUM_1);
+			sensors.setUnknown(TEMP_1);
 		} else {
-			lcd.setCursor(0, 0);
-			lcd.print("Hum 1: ");
-			lcd.print(h);
-			lcd.print(" %");
-			lcd.setCursor(0, 1);
-			lcd.print("Temp 1: ");
-			lcd.print(t);
-			lcd.print(" *C ");		
+			filter_push(&hum_filter_1, (int16_t)round(h * 10), &filtered);
+			sensors.set(HUM_1, filtered);
+			filter_push(&temp_filter_1, (int16_t)round(t * 10), &filtered);
+			sensors.set(TEMP_1, filtered);
 		}
 		
+		// send only what changed, at full speed
+		screen.flush();
+		
+		lcd.showPage(1);
+		
 		delay(2000);
 	}
 	
@@ -9,6 +9,7 @@ On 8 and 4 MHZ clocks not every read will succeed.
 */
 
 #include "DHT.h"
+#include "ClockScaling.h"
 
 DHT::DHT(uint8_t pin, uint8_t type) {
 	_pin = pin;
@@ -143,6 +144,10 @@ boolean DHT::read(bool force) {
 	}
 	_lastreadtime = current_time;
 
+	// Bits are decoded by timing pulses in software, keep the CPU at full
+	// speed until the reading is done (released on every return below).
+	ClockRequest boost(clock_div_1);
+
 	// Reset 40 bits of received data to zero.
 	data[0] = data[1] = data[2] = data[3] = data[4] = 0;
 
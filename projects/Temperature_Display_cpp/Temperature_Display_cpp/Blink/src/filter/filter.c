@@ -0,0 +1,227 @@
+/********************************************************************************
+ *
+ * Copyright (c) 2016 Krzysztof Wisniewski
+ *
+ *        ALL RIGHTS RESERVED
+ *
+ ********************************************************************************
+ *
+ * Filename       : filter.c
+ * Project        : Streaming sensor filter
+ *
+ * Description    : Every sample goes through three stages:
+ *                  median of the last N samples -> rate of change gate -> EMA.
+ *                  All the stages work in a bounded, constant time.
+ * Author         : Krzysztof Wisniewski
+ * Created        :
+ * Last Modified  :
+ * Version        :
+ *
+ *******************************************************************************/
+#include "filter.h"
+
+// @file filter.c
+// @brief Initialize the filter with a per sensor configuration
+//
+// @param filter - the filter to initialize
+// @param config - stage settings, copied into the filter
+//
+// @return filterStatus_t - Filter return status
+filterStatus_t filter_init(
+   filter_t*             filter,
+   const filterConfig_t* config
+) {
+
+   if ((filter == NULL) ||
+       (config == NULL)) {
+      return FILTER_PTR_ERROR;
+   }
+
+   // the median needs an odd window which fits into the static storage
+   if ((config->medianSize == 0) ||
+       (config->medianSize > FILTER_MEDIAN_MAX) ||
+       ((config->medianSize & 0x01) == 0) ||
+       (config->emaShift > 7)) {
+      return FILTER_CONFIG_ERROR;
+   }
+
+   filter->config = *config;
+
+   // filter_reset() keeps the counters, a new filter starts them at zero
+   filter->medianRejectCnt = 0;
+   filter->gateRejectCnt   = 0;
+
+   return filter_reset(filter);
+}
+
+// @file filter.c
+// @brief Forget the signal history, keep the configuration and counters
+//
+// @param filter
+//
+// @return filterStatus_t - Filter return status
+filterStatus_t filter_reset(
+   filter_t* filter
+) {
+
+   if (filter == NULL) {
+      return FILTER_PTR_ERROR;
+   }
+
+   filter->windowIdx     = 0;
+   filter->windowCnt     = 0;
+   filter->emaAcc        = 0;
+   filter->output        = 0;
+   filter->primed        = 0;
+   filter->gateRejectRun = 0;
+
+   return FILTER_SUCCESS;
+}
+
+// @file filter.c
+// @brief Median of the samples currently held in the window
+//
+// @param filter
+//
+// @return int16_t - the median value
+static int16_t _filter_median(
+   filter_t* filter
+) {
+   int16_t sorted[FILTER_MEDIAN_MAX];
+   uint8_t i;
+   uint8_t j;
+
+   memcpy(sorted, filter->window, filter->windowCnt * sizeof(int16_t));
+
+   // insertion sort, at most FILTER_MEDIAN_MAX elements
+   for (i = 1; i < filter->windowCnt; i++) {
+      int16_t value = sorted[i];
+
+      for (j = i; (j > 0) && (sorted[j - 1] > value); j--) {
+         sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = value;
+   }
+
+   return sorted[(filter->windowCnt - 1) >> 1];
+}
+
+// @file filter.c
+// @brief Is the newest sample an outlier: the window is full and the
+//        sample lies outside the range of the other samples in it, by
+//        more than that range is wide (and more than one unit), so
+//        ordinary noise at the edge of the window does not count
+//
+// @param filter
+// @param sample - the sample just put at the end of the window
+//
+// @return uint8_t - 1 for an outlier, 0 otherwise
+static uint8_t _filter_outlier(
+   filter_t* filter,
+   int16_t   sample
+) {
+   uint8_t newest;
+   uint8_t i;
+   int16_t min = INT16_MAX;
+   int16_t max = INT16_MIN;
+   int32_t margin;
+
+   if ((filter->config.medianSize < 2) ||
+       (filter->windowCnt < filter->config.medianSize)) {
+      return 0;
+   }
+
+   newest = (filter->windowIdx == 0) ? filter->windowCnt - 1 : filter->windowIdx - 1;
+   for (i = 0; i < filter->windowCnt; i++) {
+      if (i == newest) {
+         continue;
+      }
+      if (filter->window[i] < min) {
+         min = filter->window[i];
+      }
+      if (filter->window[i] > max) {
+         max = filter->window[i];
+      }
+   }
+
+   margin = (int32_t)max - min;
+   if (margin < 1) {
+      margin = 1;
+   }
+
+   return ((int32_t)min - sample > margin) ||
+          ((int32_t)sample - max > margin);
+}
+
+// @file filter.c
+// @brief Put a new raw sample through the filter
+//
+// @param filter
+// @param sample - raw sensor value, usually in fixed-point units (e.g. 0.1 *C)
+// @param output - filtered value, the last accepted one if the sample got rejected
+//
+// @return FILTER_SUCCESS or FILTER_REJECTED if the gate dropped the sample
+filterStatus_t filter_push(
+   filter_t* filter,
+   int16_t   sample,
+   int16_t*  output
+) {
+   int16_t median;
+   int32_t delta;
+
+   if ((filter == NULL) ||
+       (output == NULL)) {
+      return FILTER_PTR_ERROR;
+   }
+
+   // stage 1: median of the last medianSize samples
+   filter->window[filter->windowIdx] = sample;
+   if (++filter->windowIdx == filter->config.medianSize) {
+      filter->windowIdx = 0;
+   }
+   if (filter->windowCnt < filter->config.medianSize) {
+      filter->windowCnt++;
+   }
+
+   median = _filter_median(filter);
+   if ((median != sample) &&
+       _filter_outlier(filter, sample)) {
+      filter->medianRejectCnt++;
+   }
+
+   // stage 2: rate of change gate
+   if (filter->primed &&
+       (filter->config.maxDelta != FILTER_GATE_OFF)) {
+
+      delta = (int32_t)median - filter->output;
+      if (delta < 0) {
+         delta = -delta;
+      }
+
+      if (delta > filter->config.maxDelta) {
+         if (filter->gateRejectRun < filter->config.maxRejects) {
+            filter->gateRejectRun++;
+            filter->gateRejectCnt++;
+            *output = filter->output;
+            return FILTER_REJECTED;
+         }
+
+         // the signal really moved, follow it without smoothing the step
+         filter->primed = 0;
+      }
+   }
+   filter->gateRejectRun = 0;
+
+   // stage 3: exponential moving average
+   if (!filter->primed) {
+      filter->emaAcc = (int32_t)median << FILTER_EMA_FRAC_BITS;
+      filter->primed = 1;
+   } else {
+      filter->emaAcc += (((int32_t)median << FILTER_EMA_FRAC_BITS) - filter->emaAcc) >> filter->config.emaShift;
+   }
+
+   filter->output = (int16_t)((filter->emaAcc + (1 << (FILTER_EMA_FRAC_BITS - 1))) >> FILTER_EMA_FRAC_BITS);
+   *output = filter->output;
+
+   return FILTER_SUCCESS;
+}
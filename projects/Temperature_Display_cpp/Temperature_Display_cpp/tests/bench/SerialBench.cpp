@@ -0,0 +1,121 @@
+/*
+ * HardwareSerial::write() of a 40 byte telemetry line, byte by byte (what
+ * Print::write(buffer, size) did before the bulk override) against the
+ * bulk path, with the simulated USART sending at 115200 and 1 Mbaud in
+ * real time.
+ *
+ * Two figures per case:
+ * - cpu: time write() takes for a line while the ring buffer has room,
+ *   the cost a sketch pays for each line it prints;
+ * - stream: lines written back to back with interrupts off, so the
+ *   driver waits for room by polling UDRE, against the line rate.
+ *
+ * A host CPU runs the driver far faster than a 16 MHz AVR, so the line
+ * rate bounds both paths in the stream figures here; the cpu ratio is
+ * the part that carries over. At 1 Mbaud the AVR has 160 cycles per
+ * byte to keep the line busy.
+ *
+ *   make -C tests bench
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include <Arduino.h>
+#include "HardwareSerial_private.h"
+
+#include "UartSim.h"
+
+#define LINE 40
+#define CPU_LINES 20000
+#define STREAM_LINES 200
+
+class BenchSerial : public HardwareSerial
+{
+  public:
+    BenchSerial() :
+      HardwareSerial(&UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0) {}
+};
+
+static std::chrono::steady_clock::time_point epoch;
+
+static unsigned long nanoseconds()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count();
+}
+
+static void writeBytes(HardwareSerial &serial, const uint8_t *line)
+{
+  for (uint8_t i = 0; i < LINE; i++) {
+    serial.write(line[i]);
+  }
+}
+
+static void writeBulk(HardwareSerial &serial, const uint8_t *line)
+{
+  serial.write(line, LINE);
+}
+
+typedef void (*Writer)(HardwareSerial &, const uint8_t *);
+
+// write() alone, the interrupt empties the ring between lines untimed
+static double cpu(Writer writer, const uint8_t *line)
+{
+  BenchSerial serial;
+  UartSim sim(serial, 1);
+  double total = 0;
+
+  serial.begin(115200);
+  for (long i = 0; i < CPU_LINES; i++) {
+    unsigned long start = nanoseconds();
+    writer(serial, line);
+    total += nanoseconds() - start;
+    sim.serveInterrupts();
+    sim.drain();
+  }
+  return total / CPU_LINES;
+}
+
+static void stream(const char *name, Writer writer, const uint8_t *line,
+                   unsigned long baud, double cpuLine)
+{
+  BenchSerial serial;
+  // 10 bit frames, 8N1
+  UartSim sim(serial, 10000000000UL / baud, nanoseconds);
+
+  serial.begin(baud);
+  cli();
+  unsigned long start = nanoseconds();
+  for (long i = 0; i < STREAM_LINES; i++) {
+    writer(serial, line);
+  }
+  serial.flush();
+  double elapsed = nanoseconds() - start;
+  sei();
+
+  double rate = sim.sent * 1e9 / elapsed;
+  printf("  %-7lu %-6s cpu %7.1f ns/line  stream %8.0f B/s (%5.1f%% of %6lu)\n",
+         baud, name, cpuLine, rate, 100.0 * rate / (baud / 10), baud / 10);
+}
+
+int main()
+{
+  uint8_t line[LINE];
+
+  memcpy(line, "T0=23.4 H0=45.1 T1=22.9 H1=47.0 t=12345\n", LINE);
+  epoch = std::chrono::steady_clock::now();
+
+  double bytes = cpu(writeBytes, line);
+  double bulk = cpu(writeBulk, line);
+
+  printf("HardwareSerial, %d byte lines:\n", LINE);
+  static const unsigned long bauds[] = { 115200, 1000000 };
+  for (uint8_t i = 0; i < 2; i++) {
+    stream("bytes", writeBytes, line, bauds[i], bytes);
+    stream("bulk", writeBulk, line, bauds[i], bulk);
+  }
+  printf("  bulk/bytes cpu: %.2f\n", bulk / bytes);
+  return 0;
+}
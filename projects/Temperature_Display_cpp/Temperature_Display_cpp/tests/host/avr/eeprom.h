@@ -0,0 +1,3 @@
+/*
+ * Host stand-in for <avr/eeprom.h>, included by USBAPI.h; nothing used.
+ */
@@ -0,0 +1,18 @@
+/*
+ * Host stand-in for <avr/interrupt.h>: handlers become plain functions
+ * the tests can call.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#ifdef __cplusplus
+#define ISR(vector) extern "C" void vector(void); void vector(void)
+#else
+#define ISR(vector) void vector(void)
+#endif
+
+#define cli() (SREG &= ~_BV(SREG_I))
+#define sei() (SREG |= _BV(SREG_I))
+
+#endif
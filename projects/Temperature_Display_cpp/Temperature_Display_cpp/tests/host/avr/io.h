@@ -0,0 +1,74 @@
+/*
+ * Host stand-in for <avr/io.h>: the registers the tested code touches are
+ * plain variables, defined in host.cpp. Only what the tests need.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define __AVR_ATmega328P__ 1
+#define RAMSTART 0x100
+#define RAMEND 0x8FF
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_BYTE(sfr) (sfr)
+
+// Register tests through the bit macros go past hostRead when it is set,
+// so a simulated peripheral can bring the register up to date first
+// (tests/serial); plain reads see the variable as it is.
+extern uint8_t (*hostRead)(volatile uint8_t *reg);
+static inline uint8_t hostRegister(volatile uint8_t *reg)
+{
+  return hostRead ? hostRead(reg) : *reg;
+}
+#define bit_is_set(sfr, bit) (hostRegister(&(sfr)) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!(hostRegister(&(sfr)) & _BV(bit)))
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t TWBR;
+extern volatile uint8_t TWSR;
+extern volatile uint8_t TWCR;
+extern volatile uint8_t TWDR;
+
+// USART0; the names are defined to themselves for the #if defined()
+// tests of HardwareSerial.h
+extern volatile uint8_t UBRR0H;
+extern volatile uint8_t UBRR0L;
+extern volatile uint8_t UCSR0A;
+extern volatile uint8_t UCSR0B;
+extern volatile uint8_t UCSR0C;
+extern volatile uint8_t UDR0;
+#define UBRR0H UBRR0H
+#define UBRR0L UBRR0L
+#define UCSR0A UCSR0A
+#define UCSR0B UCSR0B
+#define UCSR0C UCSR0C
+#define UDR0 UDR0
+
+#define SREG_I 7
+
+#define RXC0  7
+#define TXC0  6
+#define UDRE0 5
+#define FE0   4
+#define DOR0  3
+#define UPE0  2
+#define U2X0  1
+
+#define RXCIE0 7
+#define TXCIE0 6
+#define UDRIE0 5
+#define RXEN0  4
+#define TXEN0  3
+
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+
+#endif
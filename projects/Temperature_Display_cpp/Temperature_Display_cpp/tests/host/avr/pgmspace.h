@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>: flash is ordinary memory.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for <avr/power.h>, the clock_div_t values only.
+ */
+
+#ifndef HOST_AVR_POWER_H
+#define HOST_AVR_POWER_H
+
+typedef enum {
+  clock_div_1 = 0, clock_div_2, clock_div_4, clock_div_8, clock_div_16,
+  clock_div_32, clock_div_64, clock_div_128, clock_div_256
+} clock_div_t;
+
+#endif
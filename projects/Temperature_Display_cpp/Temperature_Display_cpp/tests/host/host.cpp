@@ -0,0 +1,37 @@
+/*
+ * Registers and the Arduino core functions the tested code calls, for
+ * running it on the build machine. Time only moves when a test says so.
+ */
+
+#include <Arduino.h>
+
+#include "host.h"
+
+volatile uint8_t SREG = _BV(SREG_I);
+volatile uint8_t TWBR;
+volatile uint8_t TWSR;
+volatile uint8_t TWCR;
+volatile uint8_t TWDR;
+volatile uint8_t UBRR0H;
+volatile uint8_t UBRR0L;
+volatile uint8_t UCSR0A;
+volatile uint8_t UCSR0B;
+volatile uint8_t UCSR0C;
+volatile uint8_t UDR0;
+
+uint8_t (*hostRead)(volatile uint8_t *reg) = 0;
+
+unsigned long hostMillis = 0;
+int hostFailures = 0;
+
+unsigned long millis(void) { return hostMillis; }
+unsigned long micros(void) { return hostMillis * 1000; }
+void delayMicroseconds(unsigned int) {}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int digitalRead(uint8_t) { return HIGH; } // a free bus
+
+unsigned long getClockFrequency(void) { return F_CPU; }
+void attachClockPrescaleHandler(void (*)(uint8_t)) {}
+void detachClockPrescaleHandler(void (*)(uint8_t)) {}
@@ -0,0 +1,33 @@
+/*
+ * Shared by the host tests: time control and a minimal check macro.
+ */
+
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdio.h>
+
+// what millis() returns
+extern unsigned long hostMillis;
+
+extern int hostFailures;
+
+// report a failed condition and carry on with the test
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      hostFailures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+  do { \
+    long e_ = (long)(expected), a_ = (long)(actual); \
+    if (e_ != a_) { \
+      printf("%s:%d: %s is %ld, expected %ld\n", __FILE__, __LINE__, #actual, a_, e_); \
+      hostFailures++; \
+    } \
+  } while (0)
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * BufferedPrint in front of a target which can run out of room.
+ */
+
+#include <string.h>
+
+#include "BufferedPrint.h"
+#include "host.h"
+
+// records what reaches it, takes at most 'room' bytes in total
+class Sink : public Print
+{
+  public:
+    Sink(size_t room = sizeof(data)) : room(room), length(0), writes(0) {}
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      size_t n = size < room ? size : room;
+      memcpy(&data[length], buffer, n);
+      length += n;
+      room -= n;
+      writes++;
+      return n;
+    }
+
+    size_t room;
+    size_t length;
+    int writes;
+    uint8_t data[256];
+};
+
+static void testCombining()
+{
+  Sink sink;
+  BufferedPrint out(sink);
+
+  CHECK_EQUAL(3, out.print("T=1"));
+  CHECK_EQUAL(2, out.print("23"));
+  CHECK_EQUAL(0, sink.writes);
+  out.println();
+  CHECK_EQUAL(1, sink.writes);
+  CHECK_EQUAL(7, sink.length);
+  CHECK(memcmp(sink.data, "T=123\r\n", 7) == 0);
+  CHECK_EQUAL(0, out.getWriteError());
+}
+
+static void testLongRunPassesThrough()
+{
+  Sink sink;
+  BufferedPrint out(sink, false);
+  uint8_t run[BUFFERED_PRINT_SIZE + 8];
+
+  memset(run, 'x', sizeof(run));
+  CHECK_EQUAL(sizeof(run), out.write(run, sizeof(run)));
+  CHECK_EQUAL(1, sink.writes);
+  CHECK_EQUAL(sizeof(run), sink.length);
+}
+
+static void testShortByteWrite()
+{
+  Sink sink(4);
+  BufferedPrint out(sink);
+
+  CHECK_EQUAL(1, out.write('a'));
+  CHECK_EQUAL(1, out.write('b'));
+  CHECK_EQUAL(0, out.getWriteError());
+  // "ab" "cd" fit, the newline does not
+  CHECK_EQUAL(1, out.write('c'));
+  CHECK_EQUAL(1, out.write('d'));
+  CHECK_EQUAL(0, out.write('\n'));
+  CHECK(out.getWriteError());
+  CHECK_EQUAL(4, sink.length);
+  // the rest was dropped, not kept for later
+  CHECK_EQUAL(BUFFERED_PRINT_SIZE, out.availableForWrite());
+}
+
+static void testShortPassThrough()
+{
+  Sink sink(10);
+  BufferedPrint out(sink, false);
+  uint8_t run[BUFFERED_PRINT_SIZE];
+
+  memset(run, 'x', sizeof(run));
+  CHECK_EQUAL(10, out.write(run, sizeof(run)));
+  CHECK(out.getWriteError());
+}
+
+static void testShortBufferedWrite()
+{
+  Sink sink(5);
+  BufferedPrint out(sink);
+
+  // 3 bytes of an earlier call are in the buffer, 2 of this call get
+  // through with them
+  CHECK_EQUAL(3, out.print("abc"));
+  CHECK_EQUAL(2, out.print("de\nfg"));
+  CHECK(out.getWriteError());
+  CHECK_EQUAL(5, sink.length);
+  CHECK(memcmp(sink.data, "abcde", 5) == 0);
+
+  // a call whose bytes all stayed behind
+  out.clearWriteError();
+  sink.room = 0;
+  CHECK_EQUAL(0, out.print("hi\n"));
+  CHECK(out.getWriteError());
+}
+
+static void testSend()
+{
+  Sink sink(2);
+  BufferedPrint out(sink);
+
+  out.print("ab");
+  CHECK(out.send());
+  out.print("c");
+  CHECK(!out.send());
+  CHECK(out.getWriteError());
+  // nothing left to pass on
+  CHECK(out.send());
+}
+
+int main()
+{
+  testCombining();
+  testLongRunPassesThrough();
+  testShortByteWrite();
+  testShortPassThrough();
+  testShortBufferedWrite();
+  testSend();
+
+  printf("print: %s\n", hostFailures ? "FAILED" : "ok");
+  return hostFailures ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Number formatting of Print against the C library's printf.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "Print.h"
+#include "host.h"
+
+// collects the output, counts the write() calls
+class Text : public Print
+{
+  public:
+    Text() { clear(); }
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      memcpy(&data[length], buffer, size);
+      length += size;
+      data[length] = 0;
+      writes++;
+      return size;
+    }
+    using Print::write;
+
+    void clear() { length = 0; writes = 0; data[0] = 0; }
+
+    size_t length;
+    int writes;
+    char data[256];
+};
+
+// fixed sequence of 32-bit values, xorshift
+static uint32_t nextRandom()
+{
+  static uint32_t x = 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static int mismatches;
+
+static void expect(Text &out, const char *expected, size_t returned)
+{
+  if (strcmp(out.data, expected) != 0 || returned != strlen(expected) ||
+      out.writes != 1) {
+    if (mismatches++ < 10) {
+      printf("got \"%s\" (%u in %d writes), expected \"%s\"\n",
+             out.data, (unsigned)returned, out.writes, expected);
+    }
+    hostFailures++;
+  }
+  out.clear();
+}
+
+// random values and the edges, each base in one write()
+static void testIntegers()
+{
+  static const uint32_t edges[] = {
+    0, 1, 9, 10, 99, 100, 9999, 10000, 65535, 65536, 99999, 100000,
+    655359999, 655360000, 999999999, 1000000000, 2147483647, 2147483648u,
+    4294967295u
+  };
+  Text out;
+  char expected[40];
+
+  for (uint32_t i = 0; i < 200000 + sizeof(edges) / sizeof(edges[0]); i++) {
+    uint32_t u = i < sizeof(edges) / sizeof(edges[0]) ? edges[i] : nextRandom();
+    // small numbers are the common case, give each length its share
+    if (i & 1) {
+      u >>= u & 0x1F;
+    }
+    int32_t s = (int32_t)u;
+
+    snprintf(expected, sizeof(expected), "%lu", (unsigned long)u);
+    expect(out, expected, out.print((unsigned long)u));
+    snprintf(expected, sizeof(expected), "%ld", (long)s);
+    expect(out, expected, out.print((long)s));
+    snprintf(expected, sizeof(expected), "%lX", (unsigned long)u);
+    expect(out, expected, out.print((unsigned long)u, HEX));
+    snprintf(expected, sizeof(expected), "%lo", (unsigned long)u);
+    expect(out, expected, out.print((unsigned long)u, OCT));
+  }
+}
+
+static void testFixed()
+{
+  Text out;
+  char expected[40];
+
+  for (uint32_t i = 0; i < 100000; i++) {
+    int32_t value = (int32_t)nextRandom();
+    uint8_t digits = i % 10;
+    uint32_t scale = 1;
+    for (uint8_t d = 0; d < digits; d++) {
+      scale *= 10;
+    }
+    unsigned long n = value < 0 ? -(unsigned long)value : value;
+
+    if (digits) {
+      snprintf(expected, sizeof(expected), "%s%lu.%0*lu", value < 0 ? "-" : "",
+               n / scale, (int)digits, n % scale);
+    } else {
+      snprintf(expected, sizeof(expected), "%ld", (long)value);
+    }
+    expect(out, expected, out.printFixed(value, digits));
+  }
+
+  // padding goes after the sign with '0'
+  expect(out, "-005.3", out.printFixed(-53, 1, 6, '0'));
+  expect(out, "  -5.3", out.printFixed(-53, 1, 6));
+  expect(out, "0.05", out.printFixed(5, 2));
+}
+
+// n / d for small odd d never falls on a rounding tie, printf and the
+// scaled integer rounding have to agree there
+static void testFloat()
+{
+  static const uint8_t divisors[] = { 3, 7, 9, 11, 13 };
+  Text out;
+  char expected[40];
+
+  for (uint32_t i = 0; i < 100000; i++) {
+    long n = (long)(nextRandom() % 2000001) - 1000000;
+    double value = (double)n / divisors[i % sizeof(divisors)];
+    uint8_t digits = i % 5;
+
+    snprintf(expected, sizeof(expected), "%.*f", (int)digits, value);
+    // printf keeps the sign of a negative zero
+    if (strcmp(expected, "-0") == 0 || strncmp(expected, "-0.", 3) == 0) {
+      if (strspn(expected + 1, "0.") == strlen(expected + 1)) {
+        memmove(expected, expected + 1, strlen(expected));
+      }
+    }
+    expect(out, expected, out.print(value, digits));
+  }
+}
+
+// format() against snprintf with the same arguments; on the host int
+// is 32 bits and long 64, so hex widths differ from the AVR
+static void testFormat()
+{
+  Text out;
+  char expected[300];
+
+  snprintf(expected, sizeof(expected), "%x %X %lx", -1, -2, -1L);
+  expect(out, expected, out.format(F("%x %X %lx"), -1, -2, -1L));
+  snprintf(expected, sizeof(expected), "%d|%5d|%-5d|%05d", -42, -42, -42, -42);
+  expect(out, expected, out.format(F("%d|%5d|%-5d|%05d"), -42, -42, -42, -42));
+  snprintf(expected, sizeof(expected), "%lu %.3s %c", 4000000000ul, "abcdef", 'z');
+  expect(out, expected, out.format(F("%lu %.3s %c"), 4000000000ul, "abcdef", 'z'));
+
+  // a width or precision beyond its field clamps instead of wrapping
+  out.format(F("%300d"), 7);
+  CHECK_EQUAL(255, out.length);
+  CHECK(out.data[253] == ' ' && out.data[254] == '7');
+  out.clear();
+  out.format(F("%.200s"), "abc");
+  CHECK_EQUAL(3, out.length);
+  out.clear();
+  out.format(F("%.200f"), 1.5);
+  CHECK(out.length > 4);
+  out.clear();
+}
+
+int main()
+{
+  testIntegers();
+  testFixed();
+  testFloat();
+  testFormat();
+
+  printf("format: %s\n", hostFailures ? "FAILED" : "ok");
+  return hostFailures ? 1 : 0;
+}
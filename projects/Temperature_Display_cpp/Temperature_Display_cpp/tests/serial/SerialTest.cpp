@@ -0,0 +1,166 @@
+/*
+ * HardwareSerial transmit paths against the simulated USART.
+ */
+
+#include <string.h>
+
+#include <Arduino.h>
+#include "HardwareSerial_private.h"
+
+#include "UartSim.h"
+#include "host.h"
+
+// the driver on the USART0 registers of host.cpp, with its state exposed
+class TestSerial : public HardwareSerial
+{
+  public:
+    TestSerial() :
+      HardwareSerial(&UBRR0H, &UBRR0L, &UCSR0A, &UCSR0B, &UCSR0C, &UDR0) {}
+
+    bool written() { return _written; }
+    tx_buffer_index_t head() { return _tx_buffer_head; }
+    tx_buffer_index_t tail() { return _tx_buffer_tail; }
+};
+
+// 0, 1, 2, ... from 'first'
+static void pattern(uint8_t *buffer, size_t size, uint8_t first)
+{
+  for (size_t i = 0; i < size; i++) {
+    buffer[i] = first + i;
+  }
+}
+
+static bool sentInOrder(UartSim &sim, unsigned long from, size_t size, uint8_t first)
+{
+  for (size_t i = 0; i < size; i++) {
+    if (sim.log[from + i] != (uint8_t)(first + i)) {
+      printf("byte %lu is %u, expected %u\n", (unsigned long)(from + i),
+             sim.log[from + i], (uint8_t)(first + i));
+      return false;
+    }
+  }
+  return true;
+}
+
+static void testWritten()
+{
+  TestSerial serial;
+  UartSim sim(serial, 3);
+  serial.begin(115200);
+
+  CHECK(!serial.written());
+  serial.flush();  // nothing written, must not wait for TXC
+  CHECK_EQUAL(0, serial.write((const uint8_t *)"", 0));
+  CHECK(!serial.written());
+  CHECK_EQUAL(1, serial.write((const uint8_t *)"a", 1));
+  CHECK(serial.written());
+
+  serial.flush();
+  CHECK_EQUAL(1, sim.sent);
+  CHECK_EQUAL('a', sim.log[0]);
+}
+
+// an idle transmitter takes the first byte straight into UDR, the rest
+// goes to the ring buffer behind one interrupt enable
+static void testDirectFirstByte()
+{
+  TestSerial serial;
+  UartSim sim(serial, 3);
+  uint8_t data[5];
+  serial.begin(115200);
+
+  pattern(data, sizeof(data), 10);
+  CHECK_EQUAL(5, serial.write(data, sizeof(data)));
+  CHECK_EQUAL(0, serial.tail());
+  CHECK_EQUAL(4, serial.head());
+  CHECK(UCSR0B & _BV(UDRIE0));
+
+  CHECK_EQUAL(4, sim.serveInterrupts());
+  sim.drain();
+  CHECK_EQUAL(5, sim.sent);
+  CHECK(sentInOrder(sim, 0, 5, 10));
+  CHECK_EQUAL(0, sim.overruns);
+  CHECK(!(UCSR0B & _BV(UDRIE0)));
+}
+
+static void testWrapAround()
+{
+  TestSerial serial;
+  UartSim sim(serial, 3);
+  uint8_t data[SERIAL_TX_BUFFER_SIZE];
+  serial.begin(115200);
+
+  // move the indices close to the end of the ring
+  pattern(data, SERIAL_TX_BUFFER_SIZE - 4, 0);
+  serial.write(data, SERIAL_TX_BUFFER_SIZE - 4);
+  sim.serveInterrupts();
+  sim.drain();
+  CHECK_EQUAL(SERIAL_TX_BUFFER_SIZE - 5, serial.head());
+  CHECK_EQUAL(serial.head(), serial.tail());
+
+  // 1 direct, 19 buffered across the end
+  pattern(data, 20, 100);
+  CHECK_EQUAL(20, serial.write(data, 20));
+  CHECK_EQUAL(14, serial.head());
+  CHECK_EQUAL(SERIAL_TX_BUFFER_SIZE - 1 - 19, serial.availableForWrite());
+
+  sim.serveInterrupts();
+  sim.drain();
+  CHECK_EQUAL(SERIAL_TX_BUFFER_SIZE - 4 + 20, sim.sent);
+  CHECK(sentInOrder(sim, SERIAL_TX_BUFFER_SIZE - 4, 20, 100));
+  CHECK_EQUAL(0, sim.overruns);
+}
+
+// with interrupts off a full buffer is emptied by polling UDRE
+static void testFullBufferInterruptsOff()
+{
+  TestSerial serial;
+  UartSim sim(serial, 3);
+  uint8_t data[3 * SERIAL_TX_BUFFER_SIZE];
+  serial.begin(115200);
+
+  pattern(data, sizeof(data), 0);
+  cli();
+  CHECK_EQUAL(sizeof(data), serial.write(data, sizeof(data)));
+  CHECK(sim.busyPolls > 0);
+  // the rest leaves from flush(), still with interrupts off
+  serial.flush();
+  sei();
+
+  CHECK_EQUAL(sizeof(data), sim.sent);
+  CHECK(sentInOrder(sim, 0, sizeof(data), 0));
+  CHECK_EQUAL(0, sim.overruns);
+  CHECK(!(UCSR0B & _BV(UDRIE0)));
+}
+
+// the single byte path and the bulk one can be mixed
+static void testMixedWrites()
+{
+  TestSerial serial;
+  UartSim sim(serial, 3);
+  uint8_t data[10];
+  serial.begin(115200);
+
+  pattern(data, sizeof(data), 1);
+  serial.write(data[0]);
+  serial.write(&data[1], 8);
+  serial.write(data[9]);
+  sim.serveInterrupts();
+  sim.drain();
+
+  CHECK_EQUAL(10, sim.sent);
+  CHECK(sentInOrder(sim, 0, 10, 1));
+  CHECK_EQUAL(0, sim.overruns);
+}
+
+int main()
+{
+  testWritten();
+  testDirectFirstByte();
+  testWrapAround();
+  testFullBufferInterruptsOff();
+  testMixedWrites();
+
+  printf("serial: %s\n", hostFailures ? "FAILED" : "ok");
+  return hostFailures ? 1 : 0;
+}
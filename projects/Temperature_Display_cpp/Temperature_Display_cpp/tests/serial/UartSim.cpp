@@ -0,0 +1,121 @@
+/*
+ * A simulated USART transmitter for testing HardwareSerial on the host.
+ */
+
+#include "UartSim.h"
+
+#include <Arduino.h>
+
+UartSim *UartSim::active = 0;
+
+UartSim::UartSim(HardwareSerial &serial, unsigned long frame,
+                 unsigned long (*clock)()) :
+  sent(0), overruns(0), busyPolls(0),
+  _serial(serial), _frame(frame), _clock(clock), _ticks(0),
+  _full(false), _data(0), _shifting(false), _shifter(0), _shiftEnd(0),
+  _txc(false)
+{
+  UCSR0A = 0;
+  UCSR0B = 0;
+  UDR0 = 0;
+  active = this;
+  hostRead = read;
+}
+
+UartSim::~UartSim()
+{
+  hostRead = 0;
+  active = 0;
+}
+
+unsigned long UartSim::now()
+{
+  return _clock ? _clock() : _ticks;
+}
+
+uint8_t UartSim::read(volatile uint8_t *reg)
+{
+  UartSim *sim = active;
+
+  if (reg != &UCSR0A) {
+    return *reg;
+  }
+  if (!sim->_clock) {
+    sim->_ticks++;
+  }
+  sim->sync();
+  sim->update();
+  if (sim->_full) {
+    sim->busyPolls++;
+  }
+  return (UCSR0A & ~(_BV(TXC0) | _BV(UDRE0))) |
+         (sim->_full ? 0 : _BV(UDRE0)) | (sim->_txc ? _BV(TXC0) : 0);
+}
+
+// a TXC bit written by the driver follows a write to UDR
+void UartSim::sync()
+{
+  if (!(UCSR0A & _BV(TXC0))) {
+    return;
+  }
+  UCSR0A &= ~_BV(TXC0);
+  _txc = false;
+  if (_full) {
+    overruns++;
+  }
+  if (_shifting) {
+    _full = true;
+    _data = UDR0;
+  } else {
+    shift(UDR0, now());
+  }
+}
+
+void UartSim::shift(uint8_t c, unsigned long start)
+{
+  _shifting = true;
+  _shifter = c;
+  _shiftEnd = start + _frame;
+}
+
+// frames which ended by now, each one takes the next from UDR
+void UartSim::update()
+{
+  unsigned long time = now();
+
+  while (_shifting && (long)(time - _shiftEnd) >= 0) {
+    if (sent < UART_SIM_LOG) {
+      log[sent] = _shifter;
+    }
+    sent++;
+    _shifting = false;
+    if (_full) {
+      _full = false;
+      shift(_data, _shiftEnd);
+    } else {
+      _txc = true;
+    }
+  }
+}
+
+unsigned long UartSim::serveInterrupts()
+{
+  unsigned long calls = 0;
+
+  while (UCSR0B & _BV(UDRIE0)) {
+    if (read(&UCSR0A) & _BV(UDRE0)) {
+      _serial._tx_udr_empty_irq();
+      calls++;
+    }
+  }
+  sync();
+  return calls;
+}
+
+void UartSim::drain()
+{
+  sync();
+  while (_shifting) {
+    read(&UCSR0A);
+  }
+}
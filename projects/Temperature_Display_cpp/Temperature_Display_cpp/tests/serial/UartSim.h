@@ -0,0 +1,66 @@
+/*
+ * A simulated USART transmitter for testing HardwareSerial on the host.
+ */
+
+#ifndef UART_SIM_H
+#define UART_SIM_H
+
+#include <inttypes.h>
+
+#include <HardwareSerial.h>
+
+#define UART_SIM_LOG 512
+
+// The data register and the shift register behind it, on the USART0
+// registers of host.cpp. A write to UDR is recognised by the TXC bit the
+// driver writes right after each one (TXC is write-one-to-clear, so the
+// sim keeps the hardware's TXC to itself and shows it through hostRead).
+//
+// Time is counted in the units of a clock function, one frame takes
+// 'frame' of them. Without a clock every register test through the bit
+// macros is one unit, enough to move the tests along.
+class UartSim {
+public:
+  UartSim(HardwareSerial &serial, unsigned long frame,
+          unsigned long (*clock)() = 0);
+  ~UartSim();
+
+  // Run the UDRE interrupt for as long as it is enabled, the way the
+  // hardware would with interrupts on. Returns the number of handler
+  // calls.
+  unsigned long serveInterrupts();
+
+  // Let time pass until the last byte left the shift register.
+  void drain();
+
+  // bytes which left the shift register, the first UART_SIM_LOG of them
+  uint8_t log[UART_SIM_LOG];
+  unsigned long sent;
+  // UDR written while it still held a byte
+  unsigned long overruns;
+  // register tests which found UDR still full
+  unsigned long busyPolls;
+
+private:
+  static uint8_t read(volatile uint8_t *reg);
+  unsigned long now();
+  void update();
+  void sync();
+  void shift(uint8_t c, unsigned long start);
+
+  static UartSim *active;
+
+  HardwareSerial &_serial;
+  unsigned long _frame;
+  unsigned long (*_clock)();
+  unsigned long _ticks;
+
+  bool _full;         // UDR holds a byte
+  uint8_t _data;
+  bool _shifting;
+  uint8_t _shifter;
+  unsigned long _shiftEnd;
+  bool _txc;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * A simulated TWI peripheral for testing TwiMasterClass on the host.
+ */
+
+#include "TwiSim.h"
+
+#include <Arduino.h>
+#include <util/twi.h>
+
+#include "Twi.h"
+
+// no interrupt follows, the master left the bus or waits for nothing
+#define TWI_SIM_IDLE -1
+
+TwiSim::TwiSim() :
+  traceLength(0), starts(0), repeatedStarts(0), stops(0), strayWrites(0),
+  _deviceCount(0), _data(0), _last(0), _owner(false), _selected(0),
+  _arbitration(0), _busError(false)
+{
+}
+
+void TwiSim::attach(TwiSimDevice *device)
+{
+  _devices[_deviceCount++] = device;
+}
+
+TwiSimDevice *TwiSim::find(uint8_t address)
+{
+  for (uint8_t i = 0; i < _deviceCount; i++) {
+    if (_devices[i]->address == address) {
+      return _devices[i];
+    }
+  }
+  return 0;
+}
+
+uint8_t TwiSim::run()
+{
+  uint8_t interrupts = 0;
+  uint8_t twcr = TWCR;
+
+  while (twcr & _BV(TWINT)) {
+    int16_t status = action(twcr);
+    if (status == TWI_SIM_IDLE) {
+      break;
+    }
+    if (traceLength < TWI_SIM_TRACE) {
+      trace[traceLength++] = status;
+    }
+    interrupts++;
+
+    // TWCR written from inside step(), by a callback, reaches the
+    // hardware first; the value step() returns then lands on a
+    // peripheral which is already busy with it and is lost
+    TWCR = 0;
+    twcr = TwiMasterClass::step(status, _data);
+    if (TWCR != 0) {
+      strayWrites++;
+      twcr = TWCR;
+    }
+  }
+  TWCR = twcr;
+  return interrupts;
+}
+
+// the status after carrying out a TWCR value
+int16_t TwiSim::action(uint8_t twcr)
+{
+  if (_busError) {
+    _busError = false;
+    _owner = false;
+    return _last = TW_BUS_ERROR;
+  }
+
+  if (twcr & _BV(TWSTO)) {
+    stops++;
+    _owner = false;
+    _selected = 0;
+    if (!(twcr & _BV(TWSTA))) {
+      return TWI_SIM_IDLE;
+    }
+  }
+  if (twcr & _BV(TWSTA)) {
+    if (_owner) {
+      repeatedStarts++;
+      return _last = TW_REP_START;
+    }
+    starts++;
+    _owner = true;
+    return _last = TW_START;
+  }
+  if (!_owner) {
+    return TWI_SIM_IDLE;  // released after losing arbitration
+  }
+
+  switch (_last) {
+  case TW_START:
+  case TW_REP_START:
+    if (_arbitration) {
+      _arbitration--;
+      _owner = false;
+      return _last = TW_MT_ARB_LOST;
+    }
+    _selected = find(_data >> 1);
+    if (_data & TW_READ) {
+      return _last = _selected ? TW_MR_SLA_ACK : TW_MR_SLA_NACK;
+    }
+    if (_selected) {
+      _selected->receivedLength = 0;
+    }
+    return _last = _selected ? TW_MT_SLA_ACK : TW_MT_SLA_NACK;
+
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if (_selected->receivedLength >= _selected->nackAfter) {
+      return _last = TW_MT_DATA_NACK;
+    }
+    _selected->received[_selected->receivedLength++] = _data;
+    if (_selected->receivedLength == 1) {
+      _selected->pointer = _data % TWI_SIM_MEMORY;
+    }
+    return _last = TW_MT_DATA_ACK;
+
+  case TW_MR_SLA_ACK:
+  case TW_MR_DATA_ACK:
+    _data = _selected->memory[_selected->pointer];
+    _selected->pointer = (_selected->pointer + 1) % TWI_SIM_MEMORY;
+    return _last = (twcr & _BV(TWEA)) ? TW_MR_DATA_ACK : TW_MR_DATA_NACK;
+
+  default:
+    // after a NACK only a STOP or START moves the bus on
+    return TWI_SIM_IDLE;
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * A simulated TWI peripheral for testing TwiMasterClass on the host.
+ */
+
+#ifndef TWI_SIM_H
+#define TWI_SIM_H
+
+#include <inttypes.h>
+
+#define TWI_SIM_MEMORY 16
+#define TWI_SIM_TRACE 64
+
+// A slave on the simulated bus. The first byte of a write sets the
+// register pointer, reads continue from it, like most I2C sensors do.
+struct TwiSimDevice {
+  uint8_t address;
+  uint8_t memory[TWI_SIM_MEMORY];
+  uint8_t pointer;
+  uint8_t received[TWI_SIM_MEMORY];  // data bytes of the last write
+  uint8_t receivedLength;
+  uint8_t nackAfter;  // data bytes of a write acknowledged, then NACK
+};
+
+// The TWI hardware of the master and the bus behind it. run() does what
+// the value written to TWCR asks for, the way the peripheral would, and
+// hands the resulting status and data register to TwiMasterClass::step()
+// in place of the interrupt, until the master leaves the bus alone.
+class TwiSim {
+public:
+  TwiSim();
+
+  void attach(TwiSimDevice *device);
+
+  // The next n address phases lose arbitration to another master.
+  void loseArbitration(uint8_t n) { _arbitration = n; }
+  // The next step reports an illegal START/STOP.
+  void busError() { _busError = true; }
+
+  // Run the state machine from the current TWCR, returns the number of
+  // interrupts it took.
+  uint8_t run();
+
+  // statuses reported, in order
+  uint8_t trace[TWI_SIM_TRACE];
+  uint8_t traceLength;
+  uint8_t starts;
+  uint8_t repeatedStarts;
+  uint8_t stops;
+  // TWCR writes made while step() ran, carried out in place of its result
+  uint8_t strayWrites;
+
+private:
+  int16_t action(uint8_t twcr);
+  TwiSimDevice *find(uint8_t address);
+
+  TwiSimDevice *_devices[4];
+  uint8_t _deviceCount;
+  volatile uint8_t _data;  // TWDR
+  uint8_t _last;           // status of the last interrupt
+  bool _owner;             // the master holds the bus
+  TwiSimDevice *_selected;
+  uint8_t _arbitration;
+  bool _busError;
+};
+
+#endif
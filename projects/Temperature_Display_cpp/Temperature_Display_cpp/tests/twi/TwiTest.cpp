@@ -0,0 +1,323 @@
+/*
+ * TwiMasterClass state machine against the simulated peripheral.
+ */
+
+#include <Arduino.h>
+#include <util/twi.h>
+
+#include "Twi.h"
+#include "TwiSim.h"
+#include "host.h"
+
+static TwiSimDevice sensor(uint8_t address)
+{
+  TwiSimDevice device = {};
+  device.address = address;
+  device.nackAfter = TWI_SIM_MEMORY;
+  for (uint8_t i = 0; i < TWI_SIM_MEMORY; i++) {
+    device.memory[i] = 0xA0 + i;
+  }
+  return device;
+}
+
+static TwiTransaction transaction(uint8_t address,
+                                  const uint8_t *tx, uint8_t txLength,
+                                  uint8_t *rx, uint8_t rxLength)
+{
+  TwiTransaction t = {};
+  t.address = address;
+  t.txData = tx;
+  t.txLength = txLength;
+  t.rxData = rx;
+  t.rxLength = rxLength;
+  return t;
+}
+
+static void testWrite()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  sim.attach(&device);
+
+  const uint8_t data[] = { 1, 2, 3 };
+  TwiTransaction t = transaction(0x27, data, sizeof(data), 0, 0);
+  CHECK(TwiMaster.submit(&t));
+  CHECK(TwiMaster.busy());
+  CHECK_EQUAL(5, sim.run());
+
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK(!TwiMaster.busy());
+  CHECK_EQUAL(TW_START, sim.trace[0]);
+  CHECK_EQUAL(TW_MT_SLA_ACK, sim.trace[1]);
+  CHECK_EQUAL(TW_MT_DATA_ACK, sim.trace[4]);
+  CHECK_EQUAL(3, device.receivedLength);
+  CHECK_EQUAL(3, device.received[2]);
+  CHECK_EQUAL(1, sim.stops);
+}
+
+static void testRead()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x40);
+  sim.attach(&device);
+
+  uint8_t data[3] = {};
+  TwiTransaction t = transaction(0x40, 0, 0, data, sizeof(data));
+  TwiMaster.submit(&t);
+  sim.run();
+
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK_EQUAL(TW_MR_SLA_ACK, sim.trace[1]);
+  CHECK_EQUAL(TW_MR_DATA_ACK, sim.trace[2]);
+  CHECK_EQUAL(TW_MR_DATA_NACK, sim.trace[4]);  // the last byte ends it
+  CHECK_EQUAL(0xA0, data[0]);
+  CHECK_EQUAL(0xA2, data[2]);
+}
+
+static void testReadOneByte()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x40);
+  sim.attach(&device);
+
+  uint8_t data = 0;
+  TwiTransaction t = transaction(0x40, 0, 0, &data, 1);
+  TwiMaster.submit(&t);
+  CHECK_EQUAL(3, sim.run());
+
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK_EQUAL(TW_MR_DATA_NACK, sim.trace[2]);
+  CHECK_EQUAL(0xA0, data);
+}
+
+static void testRepeatedStart()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x40);
+  sim.attach(&device);
+
+  const uint8_t reg = 4;
+  uint8_t data[2] = {};
+  TwiTransaction t = transaction(0x40, &reg, 1, data, sizeof(data));
+  TwiMaster.submit(&t);
+  sim.run();
+
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK_EQUAL(1, sim.starts);
+  CHECK_EQUAL(1, sim.repeatedStarts);
+  CHECK_EQUAL(1, sim.stops);
+  CHECK_EQUAL(TW_REP_START, sim.trace[3]);
+  CHECK_EQUAL(0xA4, data[0]);
+  CHECK_EQUAL(0xA5, data[1]);
+}
+
+static void testNackAddress()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x40);
+  sim.attach(&device);
+
+  const uint8_t data[] = { 1 };
+  uint8_t rx = 0;
+  TwiTransaction write = transaction(0x41, data, 1, 0, 0);
+  TwiTransaction read = transaction(0x41, 0, 0, &rx, 1);
+  TwiMaster.submit(&write);
+  TwiMaster.submit(&read);
+  sim.run();
+
+  CHECK_EQUAL(TWI_NACK_ADDRESS, write.status);
+  CHECK_EQUAL(TW_MT_SLA_NACK, sim.trace[1]);
+  CHECK_EQUAL(TWI_NACK_ADDRESS, read.status);
+  CHECK_EQUAL(TW_MR_SLA_NACK, sim.trace[3]);
+  CHECK(!TwiMaster.busy());
+}
+
+static void testNackData()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  device.nackAfter = 1;
+  sim.attach(&device);
+
+  const uint8_t data[] = { 1, 2, 3 };
+  TwiTransaction t = transaction(0x27, data, sizeof(data), 0, 0);
+  TwiMaster.submit(&t);
+  sim.run();
+
+  CHECK_EQUAL(TWI_NACK_DATA, t.status);
+  CHECK_EQUAL(1, device.receivedLength);
+  CHECK_EQUAL(1, sim.stops);
+}
+
+static void testArbitrationRetry()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  sim.attach(&device);
+  sim.loseArbitration(TWI_ARBITRATION_RETRIES);
+
+  const uint8_t data[] = { 7 };
+  TwiTransaction t = transaction(0x27, data, 1, 0, 0);
+  TwiMaster.submit(&t);
+  sim.run();
+
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK_EQUAL(TW_MT_ARB_LOST, sim.trace[1]);
+  CHECK_EQUAL(TWI_ARBITRATION_RETRIES + 1, sim.starts);
+  CHECK_EQUAL(7, device.received[0]);
+}
+
+static void testArbitrationLost()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  sim.attach(&device);
+  sim.loseArbitration(TWI_ARBITRATION_RETRIES + 1);
+
+  const uint8_t data[] = { 7 };
+  TwiTransaction lost = transaction(0x27, data, 1, 0, 0);
+  TwiTransaction next = transaction(0x27, data, 1, 0, 0);
+  TwiMaster.submit(&lost);
+  TwiMaster.submit(&next);
+  sim.run();
+
+  CHECK_EQUAL(TWI_ARBITRATION_LOST, lost.status);
+  // the bus belonged to the other master, no STOP of ours
+  CHECK_EQUAL(1, sim.stops);
+  CHECK_EQUAL(TWI_OK, next.status);
+}
+
+static void testBusError()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  sim.attach(&device);
+
+  const uint8_t data[] = { 1 };
+  TwiTransaction t = transaction(0x27, data, 1, 0, 0);
+  TwiMaster.submit(&t);
+  sim.busError();
+  sim.run();
+
+  CHECK_EQUAL(TWI_BUS_ERROR, t.status);
+  CHECK_EQUAL(TW_BUS_ERROR, sim.trace[0]);
+  CHECK(!TwiMaster.busy());
+}
+
+static uint8_t completed;
+static TwiTransaction *chained;
+
+static void onComplete(TwiTransaction *t)
+{
+  completed++;
+  if (t->context) {
+    TwiMaster.submit(chained);
+  }
+}
+
+static void testQueueAndCallback()
+{
+  TwiSim sim;
+  TwiSimDevice first = sensor(0x27);
+  TwiSimDevice second = sensor(0x40);
+  sim.attach(&first);
+  sim.attach(&second);
+
+  const uint8_t data[] = { 1, 2 };
+  TwiTransaction a = transaction(0x27, data, 2, 0, 0);
+  TwiTransaction b = transaction(0x40, data, 1, 0, 0);
+  a.callback = onComplete;
+  a.context = &b;  // submits b when done
+  b.callback = onComplete;
+  chained = &b;
+  completed = 0;
+
+  TwiMaster.submit(&a);
+  CHECK(!TwiMaster.submit(&a));  // already queued
+  sim.run();
+
+  CHECK_EQUAL(2, completed);
+  CHECK_EQUAL(TWI_OK, a.status);
+  CHECK_EQUAL(TWI_OK, b.status);
+  // STOP and the next START go out together
+  CHECK_EQUAL(2, sim.starts);
+  CHECK_EQUAL(2, sim.stops);
+  CHECK_EQUAL(2, first.receivedLength);
+  CHECK_EQUAL(1, second.receivedLength);
+  CHECK_EQUAL(0, sim.strayWrites);
+}
+
+static TwiTransaction *again;
+
+static void onCompleteAgain(TwiTransaction *t)
+{
+  completed++;
+  if (completed < 3) {
+    TwiMaster.submit(again);
+  }
+}
+
+// the callback submits while the queue is empty, itself and then another
+// transaction: each has to start with a STOP and a fresh START, from the
+// single TWCR write of the state machine
+static void testResubmitFromCallback()
+{
+  TwiSim sim;
+  TwiSimDevice device = sensor(0x27);
+  sim.attach(&device);
+
+  const uint8_t data[] = { 5 };
+  uint8_t rx[2];
+  TwiTransaction t = transaction(0x27, data, 1, rx, 2);
+  t.callback = onCompleteAgain;
+  again = &t;
+  completed = 0;
+
+  TwiMaster.submit(&t);
+  sim.run();
+
+  CHECK_EQUAL(3, completed);
+  CHECK_EQUAL(TWI_OK, t.status);
+  CHECK(!TwiMaster.busy());
+  CHECK_EQUAL(0, sim.strayWrites);
+  // one repeated START per transaction, for its read phase
+  CHECK_EQUAL(3, sim.starts);
+  CHECK_EQUAL(3, sim.repeatedStarts);
+  CHECK_EQUAL(3, sim.stops);
+}
+
+static void testTimeout()
+{
+  TwiSim sim;
+
+  const uint8_t data[] = { 1 };
+  TwiTransaction t = transaction(0x27, data, 1, 0, 0);
+  TwiMaster.submit(&t);
+  // a device holds SCL low, no interrupt comes
+  hostMillis += TWI_TIMEOUT + 1;
+  TwiMaster.poll();
+
+  CHECK_EQUAL(TWI_TIMEOUT_ERROR, t.status);
+  CHECK(!TwiMaster.busy());
+}
+
+int main()
+{
+  TwiMaster.begin(TWI_FREQ_FAST);
+
+  testWrite();
+  testRead();
+  testReadOneByte();
+  testRepeatedStart();
+  testNackAddress();
+  testNackData();
+  testArbitrationRetry();
+  testArbitrationLost();
+  testBusError();
+  testQueueAndCallback();
+  testResubmitFromCallback();
+  testTimeout();
+
+  printf("twi: %s\n", hostFailures ? "FAILED" : "ok");
+  return hostFailures ? 1 : 0;
+}
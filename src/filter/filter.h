@@ -0,0 +1,82 @@
+/********************************************************************************
+ *
+ * Copyright (c) 2016 Krzysztof Wisniewski
+ *
+ *        ALL RIGHTS RESERVED
+ *
+ ********************************************************************************
+ *
+ * Filename       : filter.h
+ * Project        : Streaming sensor filter
+ *
+ * Description    : Median spike rejection, rate of change gate and
+ *                  fixed-point exponential smoothing for integer samples.
+ * Author         : Krzysztof Wisniewski
+ * Created        :
+ * Last Modified  :
+ * Version        :
+ ******************************************************************/
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the longest median window, must be odd
+#define FILTER_MEDIAN_MAX    5
+
+// fractional bits kept by the exponential smoothing accumulator
+#define FILTER_EMA_FRAC_BITS 8
+
+// disables the rate of change gate when used as filterConfig_t.maxDelta
+#define FILTER_GATE_OFF      0
+
+// return codes
+typedef enum {
+   FILTER_SUCCESS = 0,
+   FILTER_REJECTED,
+   FILTER_PTR_ERROR,
+   FILTER_CONFIG_ERROR
+} filterStatus_t;
+
+/* per sensor filter configuration */
+typedef struct filterConfig_e {
+   uint8_t  medianSize; // median window length, 1 (off), 3 or 5
+   uint8_t  emaShift;   // smoothing factor as a power of two, y += (x - y) / 2^emaShift, 0 (off) to 7
+   uint16_t maxDelta;   // largest accepted step between two outputs, FILTER_GATE_OFF disables the gate
+   uint8_t  maxRejects; // after that many consecutive gate rejections the step is accepted as real
+} filterConfig_t;
+
+/* filter definition */
+typedef struct filter_e {
+   filterConfig_t config;
+   int16_t        window[FILTER_MEDIAN_MAX]; // the last medianSize raw samples
+   uint8_t        windowIdx;                 // the next slot to overwrite in the window
+   uint8_t        windowCnt;                 // the number of valid samples in the window
+   int32_t        emaAcc;                    // smoothed value with FILTER_EMA_FRAC_BITS fractional bits
+   int16_t        output;                    // the last produced output
+   uint8_t        primed;                    // set once the first sample went through the filter
+   uint8_t        gateRejectRun;             // consecutive samples rejected by the gate
+   uint16_t       medianRejectCnt;           // samples replaced by the median of their window
+   uint16_t       gateRejectCnt;             // samples dropped by the rate of change gate
+} filter_t;
+
+filterStatus_t filter_init(filter_t*             filter,
+                           const filterConfig_t* config);
+filterStatus_t filter_reset(filter_t* filter);
+filterStatus_t filter_push(filter_t* filter,
+                           int16_t   sample,
+                           int16_t*  output);
+#define filter_getOutput(filterPtr)          ((filterPtr)->output)
+#define filter_getMedianRejectCnt(filterPtr) ((filterPtr)->medianRejectCnt)
+#define filter_getGateRejectCnt(filterPtr)   ((filterPtr)->gateRejectCnt)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FILTER_H